@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui sql concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,13 +9,49 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    cameragroups.cpp \
+    cardpreviews.cpp \
+    colmapdatabase.cpp \
+    colmapmodel.cpp \
     cubewidget.cpp \
+    exifreader.cpp \
+    imageindex.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    matchgraphdialog.cpp \
+    modelviewer.cpp \
+    pipelinecheckpoint.cpp \
+    pointcloud.cpp \
+    pointindex.cpp \
+    reconstructionpipeline.cpp \
+    resourcegovernor.cpp \
+    sessionsnapshot.cpp \
+    shardcoordinator.cpp \
+    shardprotocol.cpp \
+    shardworker.cpp \
+    startuptrace.cpp
 
 HEADERS += \
+    cameragroups.h \
+    cardpreviews.h \
+    colmapdatabase.h \
+    colmapmodel.h \
     cubewidget.h \
-    mainwindow.h
+    exifreader.h \
+    imageindex.h \
+    mainwindow.h \
+    matchgraphdialog.h \
+    modelviewer.h \
+    pipelinecheckpoint.h \
+    pointcloud.h \
+    pointindex.h \
+    reconstructionpipeline.h \
+    resourcegovernor.h \
+    sessionsnapshot.h \
+    shardcoordinator.h \
+    shardprotocol.h \
+    shardworker.h \
+    startuptrace.h
 
 FORMS += \
     mainwindow.ui
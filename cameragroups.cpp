@@ -0,0 +1,235 @@
+#include "cameragroups.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QAtomicInt>
+#include <algorithm>
+
+namespace
+{
+    QString groupId(int index)
+    {
+        // A..Z, then AA, AB, ...
+        QString id;
+        for (++index; index > 0; index = (index - 1) / 26)
+            id.prepend(QChar('A' + (index - 1) % 26));
+        return id;
+    }
+
+    // groupId order: shorter ids first, so Z comes before AA
+    bool idLess(const QString &a, const QString &b)
+    {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    }
+}
+
+QString CameraGroup::cameraParams() const
+{
+    const double f = exif.focalPixels();
+    if (f <= 0 || exif.width <= 0 || exif.height <= 0) return QString();
+    return QString("%1,%2,%3,0").arg(f, 0, 'f', 2).arg(exif.width / 2.0).arg(exif.height / 2.0);
+}
+
+CameraGroups::CameraGroups(const QString &folder)
+    : projectFolder(folder)
+{
+}
+
+QHash<QString, ExifInfo> CameraGroups::readAll(const QStringList &paths)
+{
+    const QVector<ExifInfo> infos = QtConcurrent::blockingMapped<QVector<ExifInfo>>(paths, &ExifReader::read);
+    QHash<QString, ExifInfo> out;
+    for (int i = 0; i < paths.size(); ++i)
+        out.insert(paths[i], infos[i]);
+    return out;
+}
+
+QString CameraGroups::keyFor(const ExifInfo &e)
+{
+    if (!e.hasExif())
+        return QString("unknown|%1x%2").arg(e.width).arg(e.height);
+    return QString("%1|%2|%3x%4|%5").arg(e.make, e.model).arg(e.width).arg(e.height).arg(e.focalMm, 0, 'f', 1);
+}
+
+bool CameraGroups::addMissing(const QStringList &fileNames)
+{
+    QStringList unseen;
+    for (const QString &name : fileNames)
+        if (!perImage.contains(name)) unseen << QDir(projectFolder).filePath(name);
+    if (unseen.isEmpty()) return false;
+
+    const QHash<QString, ExifInfo> exif = readAll(unseen);
+    for (auto it = exif.constBegin(); it != exif.constEnd(); ++it)
+        set(QFileInfo(it.key()).fileName(), it.value());
+    return true;
+}
+
+void CameraGroups::set(const QString &fileName, const ExifInfo &exif)
+{
+    perImage.insert(fileName, exif);
+    assignId(keyFor(exif));
+}
+
+void CameraGroups::assignId(const QString &key)
+{
+    if (!idByKey.contains(key))
+        idByKey.insert(key, groupId(nextId++));
+}
+
+void CameraGroups::remove(const QString &fileName)
+{
+    perImage.remove(fileName);
+}
+
+QVector<CameraGroup> CameraGroups::groups() const
+{
+    QMap<QString, CameraGroup> byKey;
+    for (auto it = perImage.constBegin(); it != perImage.constEnd(); ++it) {
+        CameraGroup &g = byKey[keyFor(it.value())];
+        if (g.images.isEmpty()) {
+            const ExifInfo &e = it.value();
+            g.key = keyFor(e);
+            g.exif = e;
+            QString name = QString("%1 %2").arg(e.make, e.model).trimmed();
+            if (name.isEmpty()) name = "Unknown camera";
+            g.label = e.focalMm > 0 ? QString("%1, %2 mm, %3x%4").arg(name).arg(e.focalMm).arg(e.width).arg(e.height)
+                                    : QString("%1, %2x%3").arg(name).arg(e.width).arg(e.height);
+        }
+        g.images << it.key();
+    }
+
+    QVector<CameraGroup> out;
+    for (CameraGroup &g : byKey) {
+        g.id = idByKey.value(g.key);
+        g.images.sort();
+        out << g;
+    }
+    std::sort(out.begin(), out.end(), [](const CameraGroup &a, const CameraGroup &b) { return idLess(a.id, b.id); });
+    return out;
+}
+
+QHash<QString, QString> CameraGroups::groupIds() const
+{
+    QHash<QString, QString> ids;
+    for (const CameraGroup &g : groups())
+        for (const QString &name : g.images)
+            ids.insert(name, g.id);
+    return ids;
+}
+
+bool CameraGroups::shareCameras(const QString &databasePath, QString *error) const
+{
+    static QAtomicInt connectionCounter;
+    const QString connectionName = QString("cameragroups-%1").arg(connectionCounter.fetchAndAddRelaxed(1));
+
+    QString failure;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databasePath);
+        if (!db.open()) {
+            failure = db.lastError().text();
+        } else {
+            QSqlQuery q(db);
+            auto run = [&](const QString &sql) {
+                if (failure.isEmpty() && !q.exec(sql)) failure = q.lastError().text();
+            };
+            run("BEGIN");
+            run("CREATE TEMP TABLE grouped (name TEXT PRIMARY KEY)");
+            for (const CameraGroup &g : groups()) {
+                if (!g.sharesCamera() || g.images.size() < 2) continue;
+                run("DELETE FROM grouped");
+                if (failure.isEmpty()) {
+                    q.prepare("INSERT INTO grouped (name) VALUES (?)");
+                    q.addBindValue(g.images);
+                    if (!q.execBatch()) failure = q.lastError().text();
+                }
+                run("UPDATE images SET camera_id = "
+                    "(SELECT MIN(camera_id) FROM images WHERE name IN (SELECT name FROM grouped)) "
+                    "WHERE name IN (SELECT name FROM grouped)");
+            }
+            run("DELETE FROM cameras WHERE camera_id NOT IN (SELECT DISTINCT camera_id FROM images)");
+            if (failure.isEmpty())
+                run("COMMIT");
+            else
+                q.exec("ROLLBACK");
+            q.exec("DROP TABLE grouped");
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    if (error) *error = failure;
+    return failure.isEmpty();
+}
+
+bool CameraGroups::load()
+{
+    perImage.clear();
+    idByKey.clear();
+    nextId = 0;
+    QFile f(QDir(projectFolder).filePath(".voxelforge/cameras.json"));
+    if (!f.open(QIODevice::ReadOnly)) return false;
+
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll()).object();
+    const QJsonObject ids = root.value("groups").toObject();
+    for (auto it = ids.constBegin(); it != ids.constEnd(); ++it)
+        idByKey.insert(it.key(), it.value().toString());
+    nextId = qMax(root.value("nextGroup").toInt(), idByKey.size());
+
+    const QJsonObject images = root.value("images").toObject();
+    for (auto it = images.constBegin(); it != images.constEnd(); ++it) {
+        const QJsonObject o = it.value().toObject();
+        ExifInfo e;
+        e.make = o.value("make").toString();
+        e.model = o.value("model").toString();
+        e.width = o.value("width").toInt();
+        e.height = o.value("height").toInt();
+        e.focalMm = o.value("focalMm").toDouble();
+        e.focal35mm = o.value("focal35mm").toDouble();
+        e.sensorWidthMm = o.value("sensorWidthMm").toDouble();
+        perImage.insert(it.key(), e);
+    }
+
+    // Files from before ids were stored numbered the groups in key order;
+    // giving the unnumbered keys ids in that order keeps what they showed
+    QStringList unnumbered;
+    for (const ExifInfo &e : perImage)
+        if (!idByKey.contains(keyFor(e)) && !unnumbered.contains(keyFor(e))) unnumbered << keyFor(e);
+    unnumbered.sort();
+    for (const QString &key : unnumbered)
+        assignId(key);
+    return true;
+}
+
+bool CameraGroups::save() const
+{
+    QJsonObject images;
+    for (auto it = perImage.constBegin(); it != perImage.constEnd(); ++it) {
+        const ExifInfo &e = it.value();
+        images.insert(it.key(), QJsonObject{
+            { "make", e.make }, { "model", e.model },
+            { "width", e.width }, { "height", e.height },
+            { "focalMm", e.focalMm }, { "focal35mm", e.focal35mm },
+            { "sensorWidthMm", e.sensorWidthMm },
+        });
+    }
+
+    const QString path = QDir(projectFolder).filePath(".voxelforge/cameras.json");
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    QJsonObject ids;
+    for (auto it = idByKey.constBegin(); it != idByKey.constEnd(); ++it)
+        ids.insert(it.key(), it.value());
+    f.write(QJsonDocument(QJsonObject{ { "images", images }, { "groups", ids }, { "nextGroup", nextId } })
+                .toJson(QJsonDocument::Compact));
+    return f.commit();
+}
@@ -0,0 +1,74 @@
+#ifndef CAMERAGROUPS_H
+#define CAMERAGROUPS_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include "exifreader.h"
+
+// Images that should share one set of intrinsics in COLMAP: same make,
+// model, resolution and focal length.
+struct CameraGroup
+{
+    QString id;                // "A", "B", ... in order of first appearance, never reused
+    QString key;
+    QString label;             // human readable, e.g. "Canon EOS 80D, 24 mm, 6000x4000"
+    ExifInfo exif;             // of the first image, for the intrinsics prior
+    QStringList images;        // file names
+
+    // COLMAP SIMPLE_RADIAL parameters (f, cx, cy, k), empty if there is no focal prior
+    QString cameraParams() const;
+
+    // Whether the images share one camera in COLMAP. Images without EXIF
+    // only share a resolution, which says nothing about the camera, so
+    // those get a camera each.
+    bool sharesCamera() const { return exif.hasExif(); }
+};
+
+// Per-project camera grouping, kept in <project>/.voxelforge/cameras.json so
+// the pipeline can use it without re-reading EXIF. A group id is given the
+// first time its key is seen and stored with it: sessions, the search index
+// and shard image lists all refer to groups by id, so an id never moves to
+// another camera or comes back for a new one.
+class CameraGroups
+{
+public:
+    explicit CameraGroups(const QString &folder = QString());
+
+    QString folder() const { return projectFolder; }
+    bool load();
+    bool save() const;
+
+    // Reads EXIF for the given absolute paths in parallel
+    static QHash<QString, ExifInfo> readAll(const QStringList &paths);
+
+    // Reads EXIF for any of these project images that are not grouped yet;
+    // true if something was added
+    bool addMissing(const QStringList &fileNames);
+
+    void set(const QString &fileName, const ExifInfo &exif);
+    void remove(const QString &fileName);
+    bool contains(const QString &fileName) const { return perImage.contains(fileName); }
+    ExifInfo exif(const QString &fileName) const { return perImage.value(fileName); }
+
+    QVector<CameraGroup> groups() const;
+    QHash<QString, QString> groupIds() const;          // file name -> group id
+
+    // feature_extractor makes a new camera on every run, so a group that
+    // was extracted in several runs or shards has several. Points every
+    // image of a shared group at the group's lowest camera_id in the COLMAP
+    // database and drops the cameras no image uses any more.
+    bool shareCameras(const QString &databasePath, QString *error = nullptr) const;
+
+private:
+    static QString keyFor(const ExifInfo &exif);
+    void assignId(const QString &key);
+
+    QString projectFolder;
+    QHash<QString, ExifInfo> perImage;
+    QHash<QString, QString> idByKey;   // kept for keys with no images left, so ids are not reused
+    int nextId = 0;
+};
+
+#endif // CAMERAGROUPS_H
@@ -0,0 +1,178 @@
+#include "cardpreviews.h"
+
+#include <QThreadPool>
+#include <QThread>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QPainter>
+#include <QPainterPath>
+#include <QMatrix4x4>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const int kPreviewSize = 250;         // matches the baked card art
+    const int kMaxPreviewPoints = 300000;
+
+    QString revision(const QString &model)
+    {
+        const QFileInfo fi(model);
+        return QString("%1|%2|%3").arg(fi.absoluteFilePath()).arg(fi.size()).arg(fi.lastModified().toMSecsSinceEpoch());
+    }
+
+    QString cachePath(const QString &project, int kind, const QString &model)
+    {
+        const QString hash = QCryptographicHash::hash(revision(model).toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+        return QDir(project).filePath(QString(".voxelforge/previews/%1-%2.png")
+                                          .arg(kind == CardPreviews::Sparse ? "sparse" : "dense", hash));
+    }
+
+    QImage renderOrLoad(const QString &project, int kind, const QString &model)
+    {
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+
+        const QString cached = cachePath(project, kind, model);
+        QImage image(cached);
+        if (!image.isNull()) return image;
+
+        image = CardPreviews::render(PointCloudLoader::load(model, kMaxPreviewPoints), QSize(kPreviewSize, kPreviewSize));
+        if (image.isNull()) return image;
+
+        // One cached revision per card is enough
+        QDir dir(QFileInfo(cached).absolutePath());
+        dir.mkpath(".");
+        const QString prefix = QFileInfo(cached).fileName().section('-', 0, 0) + "-*.png";
+        for (const QString &old : dir.entryList({ prefix }, QDir::Files))
+            dir.remove(old);
+        image.save(cached);
+        return image;
+    }
+}
+
+CardPreviews::CardPreviews(QObject *parent)
+    : QObject(parent)
+{
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(1);
+}
+
+CardPreviews::~CardPreviews()
+{
+    pool->clear();
+    pool->waitForDone();
+}
+
+void CardPreviews::request(int kind, const QString &projectFolder, const QString &modelPath)
+{
+    if (kind < 0 || kind >= KindCount || !QFileInfo::exists(modelPath)) return;
+    if (revision(modelPath) == shownRevision[kind] && !inFlight[kind]) return;
+
+    queued[kind] = { projectFolder, modelPath };
+    if (!inFlight[kind])
+        startRender(kind);
+}
+
+void CardPreviews::startRender(int kind)
+{
+    current[kind] = queued[kind];
+    queued[kind] = Request();
+    inFlight[kind] = true;
+
+    const Request r = current[kind];
+    const QString rev = revision(r.model);
+    auto *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, kind, rev]() {
+        const QImage image = watcher->result();
+        watcher->deleteLater();
+        inFlight[kind] = false;
+        if (!image.isNull()) {
+            shownRevision[kind] = rev;
+            emit previewReady(kind, image);
+        }
+        if (!queued[kind].model.isEmpty())
+            startRender(kind);
+    });
+    watcher->setFuture(QtConcurrent::run(pool, renderOrLoad, r.project, kind, r.model));
+}
+
+// Orthographic splat render from a fixed three-quarter view with a z-buffer
+QImage CardPreviews::render(const PointCloud &cloud, const QSize &size)
+{
+    if (cloud.isEmpty()) return QImage();
+
+    // Centre on the median and size by the 90th percentile distance, so a
+    // few far-off outliers don't shrink the model to a dot
+    auto median = [&](int axis) {
+        QVector<float> v;
+        v.reserve(cloud.size());
+        for (const QVector3D &p : cloud.positions) v << p[axis];
+        std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+        return v[v.size() / 2];
+    };
+    const QVector3D center(median(0), median(1), median(2));
+
+    QVector<float> dist;
+    dist.reserve(cloud.size());
+    for (const QVector3D &p : cloud.positions) dist << (p - center).length();
+    const int k = int(dist.size() * 0.9);
+    std::nth_element(dist.begin(), dist.begin() + k, dist.end());
+    const float radius = qMax(dist[k], 1e-6f);
+
+    // COLMAP's world has y pointing down; look slightly from above
+    QMatrix4x4 view;
+    view.rotate(-20.0f, 1, 0, 0);
+    view.rotate(35.0f, 0, 1, 0);
+    view.scale(1.0f, -1.0f, 1.0f);
+    view.translate(-center);
+
+    const int w = size.width(), h = size.height();
+    const float scale = 0.45f * qMin(w, h) / radius;
+    const int splat = cloud.size() < 20000 ? 2 : 1;
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(QColor("#030317"));
+    QVector<float> depth(w * h, std::numeric_limits<float>::max());
+
+    for (int i = 0; i < cloud.size(); ++i) {
+        const QVector3D v = view.map(cloud.positions[i]);
+        const int x = int(w / 2 + v.x() * scale);
+        const int y = int(h / 2 - v.y() * scale);
+        const float z = -v.z();   // distance along the view direction, smaller is nearer
+
+        // Fade with depth for a bit of shape
+        const float shade = qBound(0.45f, 0.75f - 0.3f * z / radius, 1.0f);
+        const QRgb c = cloud.colors[i];
+        const QRgb px = qRgb(int(qRed(c) * shade), int(qGreen(c) * shade), int(qBlue(c) * shade));
+
+        for (int dy = 0; dy < splat; ++dy) {
+            const int yy = y + dy;
+            if (yy < 0 || yy >= h) continue;
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(yy));
+            for (int dx = 0; dx < splat; ++dx) {
+                const int xx = x + dx;
+                if (xx < 0 || xx >= w) continue;
+                float &d = depth[yy * w + xx];
+                if (z < d) {
+                    d = z;
+                    line[xx] = px;
+                }
+            }
+        }
+    }
+
+    // Same rounded corners as the baked card art
+    QImage rounded(size, QImage::Format_ARGB32_Premultiplied);
+    rounded.fill(Qt::transparent);
+    QPainter painter(&rounded);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QPainterPath clip;
+    clip.addRoundedRect(QRectF(rounded.rect()), 15, 15);
+    painter.fillPath(clip, QBrush(image));
+    return rounded;
+}
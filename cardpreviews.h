@@ -0,0 +1,54 @@
+#ifndef CARDPREVIEWS_H
+#define CARDPREVIEWS_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include "pointcloud.h"
+
+class QThreadPool;
+
+// Small CPU splat previews of a project's models for the Project Manager
+// cards.
+//
+// Rendering runs on a private single-thread pool at idle priority, so it
+// only gets CPU the pipeline is not using. Results are cached as PNGs in
+// <project>/.voxelforge/previews, keyed by the model file's path, size and
+// modification time, so a model is only rendered once per revision. While
+// a render is in flight further requests for the same card only replace
+// the queued one (latest wins).
+class CardPreviews : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind { Sparse, Dense, KindCount };
+
+    explicit CardPreviews(QObject *parent = nullptr);
+    ~CardPreviews() override;
+
+    void request(int kind, const QString &projectFolder, const QString &modelPath);
+
+    static QImage render(const PointCloud &cloud, const QSize &size);
+
+signals:
+    void previewReady(int kind, const QImage &image);
+
+private:
+    void startRender(int kind);
+
+    struct Request
+    {
+        QString project;
+        QString model;
+    };
+
+    QThreadPool *pool = nullptr;
+    bool inFlight[KindCount] = {};
+    Request queued[KindCount];
+    Request current[KindCount];
+    QString shownRevision[KindCount];   // model revision on screen, to skip repeat requests
+};
+
+#endif // CARDPREVIEWS_H
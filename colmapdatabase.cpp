@@ -0,0 +1,206 @@
+#include "colmapdatabase.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QVariant>
+#include <QFileInfo>
+#include <QStringList>
+#include <QHash>
+#include <QAtomicInt>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFuture>
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    const qint64 kMaxNumImages = 2147483647;   // COLMAP's pair_id base
+
+    struct Row
+    {
+        qint64 id;
+        qint64 a;
+        qint64 b;
+    };
+
+    struct TableScan
+    {
+        QVector<Row> rows;
+        QStringList text;      // values of textColumn, one per row
+        QString error;
+    };
+
+    // Runs one forward-only query on a private read-only connection. Up to
+    // three integer columns are kept per row; textColumn (if >= 0) is kept
+    // as a string instead.
+    TableScan scanTable(const QString &path, const QString &sql, int textColumn)
+    {
+        static QAtomicInt connectionCounter;
+        const QString connectionName = QString("colmapdb-%1").arg(connectionCounter.fetchAndAddRelaxed(1));
+
+        TableScan scan;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            db.setDatabaseName(path);
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+            if (!db.open()) {
+                scan.error = db.lastError().text();
+            } else {
+                QSqlQuery q(db);
+                q.setForwardOnly(true);
+                if (!q.exec(sql)) {
+                    scan.error = q.lastError().text();
+                } else {
+                    const int columns = q.record().count();
+                    while (q.next()) {
+                        qint64 v[3] = { 0, 0, 0 };
+                        for (int c = 0; c < columns && c < 3; ++c) {
+                            if (c == textColumn)
+                                scan.text << q.value(c).toString();
+                            else
+                                v[c] = q.value(c).toLongLong();
+                        }
+                        scan.rows.append({ v[0], v[1], v[2] });
+                    }
+                }
+            }
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        return scan;
+    }
+
+    int findRoot(QVector<int> &parent, int i)
+    {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+}
+
+void ColmapDatabase::pairIdToImageIds(qint64 pairId, qint64 &imageId1, qint64 &imageId2)
+{
+    imageId2 = pairId % kMaxNumImages;
+    imageId1 = (pairId - imageId2) / kMaxNumImages;
+}
+
+QStringList ColmapDatabase::imagesWithFeatures(const QString &databasePath, QString *error)
+{
+    const TableScan scan = scanTable(databasePath,
+                                     QString("SELECT images.name FROM images "
+                                             "JOIN keypoints ON keypoints.image_id = images.image_id "
+                                             "JOIN descriptors ON descriptors.image_id = images.image_id "
+                                             "WHERE keypoints.rows > 0 AND descriptors.rows > 0"), 0);
+    if (error) *error = scan.error;
+    return scan.text;
+}
+
+qint64 ColmapDatabase::matchedPairCount(const QString &databasePath, QString *error)
+{
+    const TableScan scan = scanTable(databasePath, QString("SELECT COUNT(*) FROM matches WHERE rows > 0"), -1);
+    if (error) *error = scan.error;
+    return scan.rows.isEmpty() ? 0 : scan.rows.first().id;
+}
+
+ColmapMatchGraph ColmapDatabase::analyze(const QString &databasePath, int minInliers)
+{
+    ColmapMatchGraph graph;
+    if (!QFileInfo::exists(databasePath)) {
+        graph.error = QString("Database not found: %1").arg(databasePath);
+        return graph;
+    }
+
+    QFuture<TableScan> images = QtConcurrent::run(scanTable, databasePath,
+                                                  QString("SELECT image_id, camera_id, name FROM images ORDER BY image_id"), 2);
+    QFuture<TableScan> keypoints = QtConcurrent::run(scanTable, databasePath,
+                                                     QString("SELECT image_id, rows FROM keypoints"), -1);
+    QFuture<TableScan> descriptors = QtConcurrent::run(scanTable, databasePath,
+                                                       QString("SELECT image_id, rows FROM descriptors"), -1);
+    QFuture<TableScan> matches = QtConcurrent::run(scanTable, databasePath,
+                                                   QString("SELECT pair_id, rows FROM matches"), -1);
+    QFuture<TableScan> geometries = QtConcurrent::run(scanTable, databasePath,
+                                                      QString("SELECT pair_id, rows FROM two_view_geometries"), -1);
+
+    for (QFuture<TableScan> *f : { &images, &keypoints, &descriptors, &matches, &geometries }) {
+        f->waitForFinished();
+        if (graph.error.isEmpty() && !f->result().error.isEmpty())
+            graph.error = f->result().error;
+    }
+    if (!graph.ok()) return graph;
+
+    const TableScan imageScan = images.result();
+    const QVector<Row> &imageRows = imageScan.rows;
+    QHash<qint64, int> indexOf;
+    graph.images.resize(imageRows.size());
+    for (int i = 0; i < imageRows.size(); ++i) {
+        graph.images[i].imageId = imageRows[i].id;
+        graph.images[i].cameraId = imageRows[i].a;
+        graph.images[i].name = imageScan.text.value(i);
+        indexOf.insert(imageRows[i].id, i);
+    }
+
+    const TableScan keypointScan = keypoints.result();
+    for (const Row &r : keypointScan.rows) {
+        auto it = indexOf.constFind(r.id);
+        if (it != indexOf.constEnd()) graph.images[*it].keypoints = int(r.a);
+    }
+    const TableScan descriptorScan = descriptors.result();
+    for (const Row &r : descriptorScan.rows) {
+        auto it = indexOf.constFind(r.id);
+        if (it != indexOf.constEnd()) graph.images[*it].descriptors = int(r.a);
+    }
+
+    const TableScan matchScan = matches.result();
+    for (const Row &r : matchScan.rows) {
+        if (r.a <= 0) continue;
+        qint64 id1, id2;
+        pairIdToImageIds(r.id, id1, id2);
+        const int i1 = indexOf.value(id1, -1), i2 = indexOf.value(id2, -1);
+        if (i1 < 0 || i2 < 0) continue;
+        ++graph.matchedPairs;
+        for (int i : { i1, i2 }) {
+            graph.images[i].matchedPairs++;
+            graph.images[i].rawMatches += r.a;
+        }
+    }
+
+    // Union-find over the verified edges
+    QVector<int> parent(graph.images.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    const TableScan geometryScan = geometries.result();
+    for (const Row &r : geometryScan.rows) {
+        qint64 id1, id2;
+        pairIdToImageIds(r.id, id1, id2);
+        const int i1 = indexOf.value(id1, -1), i2 = indexOf.value(id2, -1);
+        if (i1 < 0 || i2 < 0) continue;
+        for (int i : { i1, i2 })
+            graph.images[i].inlierMatches += r.a;
+        if (r.a < minInliers) continue;
+        ++graph.verifiedPairs;
+        graph.images[i1].verifiedPairs++;
+        graph.images[i2].verifiedPairs++;
+        parent[findRoot(parent, i1)] = findRoot(parent, i2);
+    }
+
+    // Number components largest first
+    QHash<int, int> sizeOfRoot;
+    for (int i = 0; i < parent.size(); ++i)
+        sizeOfRoot[findRoot(parent, i)]++;
+    QList<int> roots = sizeOfRoot.keys();
+    std::sort(roots.begin(), roots.end(), [&](int a, int b) {
+        return sizeOfRoot[a] != sizeOfRoot[b] ? sizeOfRoot[a] > sizeOfRoot[b] : a < b;
+    });
+    QHash<int, int> componentOfRoot;
+    for (int c = 0; c < roots.size(); ++c) {
+        componentOfRoot.insert(roots[c], c);
+        graph.componentSizes.append(sizeOfRoot[roots[c]]);
+    }
+    for (int i = 0; i < parent.size(); ++i)
+        graph.images[i].component = componentOfRoot.value(findRoot(parent, i));
+
+    return graph;
+}
@@ -0,0 +1,60 @@
+#ifndef COLMAPDATABASE_H
+#define COLMAPDATABASE_H
+
+#include <QString>
+#include <QVector>
+#include <QStringList>
+#include <QtGlobal>
+
+// Per-image numbers pulled out of a COLMAP database.db
+struct ColmapImageStats
+{
+    qint64 imageId = 0;
+    qint64 cameraId = 0;
+    QString name;
+    int keypoints = 0;
+    int descriptors = 0;
+    int matchedPairs = 0;      // pairs with any raw matches
+    int verifiedPairs = 0;     // pairs whose two-view geometry passed minInliers
+    qint64 rawMatches = 0;
+    qint64 inlierMatches = 0;
+    int component = -1;        // index into ColmapMatchGraph::componentSizes, 0 = largest
+
+    double inlierRatio() const { return rawMatches > 0 ? double(inlierMatches) / rawMatches : 0.0; }
+};
+
+struct ColmapMatchGraph
+{
+    QVector<ColmapImageStats> images;   // ordered by image_id
+    QVector<int> componentSizes;        // largest first
+    qint64 matchedPairs = 0;
+    qint64 verifiedPairs = 0;
+    QString error;                      // non-empty if the database could not be read
+
+    bool ok() const { return error.isEmpty(); }
+};
+
+// Read-only access to COLMAP's SQLite database.
+//
+// Only the row/column headers of the keypoint, descriptor, match and
+// two-view geometry tables are read; the blobs themselves are never loaded,
+// and each table is streamed with a forward-only cursor on its own
+// connection so the tables are scanned in parallel.
+class ColmapDatabase
+{
+public:
+    // Builds per-image stats and the connected components of the verified
+    // match graph (an edge needs at least minInliers inlier matches).
+    static ColmapMatchGraph analyze(const QString &databasePath, int minInliers = 15);
+
+    // Names of images that already have both keypoints and descriptors
+    static QStringList imagesWithFeatures(const QString &databasePath, QString *error = nullptr);
+
+    // Number of image pairs with at least one raw match
+    static qint64 matchedPairCount(const QString &databasePath, QString *error = nullptr);
+
+    // COLMAP packs an image pair into one integer, see database.cc
+    static void pairIdToImageIds(qint64 pairId, qint64 &imageId1, qint64 &imageId2);
+};
+
+#endif // COLMAPDATABASE_H
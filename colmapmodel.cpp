@@ -0,0 +1,221 @@
+#include "colmapmodel.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QtNumeric>
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    template <typename T>
+    T readLE(const uchar *p)
+    {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    struct Camera
+    {
+        int width = 0;
+        int height = 0;
+        double fx = 0.0, fy = 0.0, cx = 0.0, cy = 0.0;
+    };
+
+    // Parameter count per COLMAP camera model id, see src/base/camera_models.h
+    int paramCount(int modelId)
+    {
+        static const int counts[] = { 3, 4, 4, 5, 8, 8, 12, 5, 4, 5, 12 };
+        return modelId >= 0 && modelId < int(sizeof(counts) / sizeof(counts[0])) ? counts[modelId] : -1;
+    }
+
+    // Models whose first parameters are f, cx, cy (one focal length)
+    bool singleFocal(int modelId)
+    {
+        return modelId == 0 || modelId == 2 || modelId == 3 || modelId == 8 || modelId == 9;
+    }
+
+    bool readCameras(const QString &path, QHash<quint32, Camera> &cameras, QString *error)
+    {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            if (error) *error = f.errorString();
+            return false;
+        }
+        const QByteArray data = f.readAll();   // a few hundred bytes per camera
+        const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+        const qint64 size = data.size();
+        if (size < 8) {
+            if (error) *error = "Truncated " + path;
+            return false;
+        }
+
+        // camera_id u32, model_id i32, width u64, height u64, params f64 * n
+        const quint64 count = readLE<quint64>(p);
+        qint64 pos = 8;
+        for (quint64 i = 0; i < count; ++i) {
+            if (pos + 24 > size) break;
+            const quint32 id = readLE<quint32>(p + pos);
+            const int model = readLE<qint32>(p + pos + 4);
+            const int n = paramCount(model);
+            if (n < 0 || pos + 24 + n * 8 > size) {
+                if (error) *error = QString("Unknown camera model %1 in %2").arg(model).arg(path);
+                return false;
+            }
+            Camera c;
+            c.width = int(readLE<quint64>(p + pos + 8));
+            c.height = int(readLE<quint64>(p + pos + 16));
+            const uchar *params = p + pos + 24;
+            c.fx = readLE<double>(params);
+            if (singleFocal(model)) {
+                c.fy = c.fx;
+                c.cx = readLE<double>(params + 8);
+                c.cy = readLE<double>(params + 16);
+            } else {
+                c.fy = readLE<double>(params + 8);
+                c.cx = readLE<double>(params + 16);
+                c.cy = readLE<double>(params + 24);
+            }
+            cameras.insert(id, c);
+            pos += 24 + n * 8;
+        }
+        return true;
+    }
+}
+
+QVector<QVector3D> ColmapView::frustumCorners(float depth) const
+{
+    const double corners[4][2] = { { 0, 0 }, { double(width), 0 }, { double(width), double(height) }, { 0, double(height) } };
+    QVector<QVector3D> out;
+    out.reserve(4);
+    for (const auto &c : corners) {
+        const QVector3D ray(float((c[0] - cx) / fx), float((c[1] - cy) / fy), 1.0f);
+        out << toWorld(ray * depth);
+    }
+    return out;
+}
+
+QVector<ColmapView> ColmapModel::loadViews(const QString &sparseFolder, QString *error)
+{
+    QVector<ColmapView> views;
+    const QDir dir(sparseFolder);
+
+    QHash<quint32, Camera> cameras;
+    if (!readCameras(dir.filePath("cameras.bin"), cameras, error))
+        return views;
+
+    QFile f(dir.filePath("images.bin"));
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return views;
+    }
+    const qint64 size = f.size();
+    const uchar *data = size >= 8 ? f.map(0, size) : nullptr;
+    if (!data) {
+        if (error) *error = "Could not map " + f.fileName();
+        return views;
+    }
+
+    // Per image: image_id u32, qvec 4*f64 (w x y z), tvec 3*f64, camera_id u32,
+    // name (NUL terminated), num_points2D u64, then num_points2D * (x f64, y f64, point3D_id u64)
+    // Each image takes at least its fixed part, a NUL and the point count;
+    // the header count is not trusted beyond that
+    const qint64 fixed = 4 + 32 + 24 + 4;
+    const quint64 count = qMin(readLE<quint64>(data), quint64(size - 8) / quint64(fixed + 1 + 8));
+    views.reserve(int(count));
+    qint64 pos = 8;
+    for (quint64 i = 0; i < count; ++i) {
+        if (pos + fixed > size) break;
+        const uchar *p = data + pos;
+        ColmapView v;
+        v.imageId = readLE<quint32>(p);
+        v.rotation = QQuaternion(float(readLE<double>(p + 4)), float(readLE<double>(p + 12)),
+                                 float(readLE<double>(p + 20)), float(readLE<double>(p + 28))).normalized();
+        v.translation = QVector3D(float(readLE<double>(p + 36)), float(readLE<double>(p + 44)), float(readLE<double>(p + 52)));
+        const quint32 cameraId = readLE<quint32>(p + 60);
+
+        const uchar *name = p + fixed;
+        const uchar *end = static_cast<const uchar *>(std::memchr(name, 0, size_t(size - pos - fixed)));
+        if (!end) break;
+        v.name = QString::fromUtf8(reinterpret_cast<const char *>(name), int(end - name));
+        pos += fixed + (end - name) + 1;
+        if (pos + 8 > size) break;
+        const quint64 points2D = readLE<quint64>(data + pos);
+        pos += 8;
+        if (!skipRecords(pos, points2D, 24, size)) break;
+
+        const Camera c = cameras.value(cameraId);
+        v.width = c.width;
+        v.height = c.height;
+        v.fx = c.fx;
+        v.fy = c.fy;
+        v.cx = c.cx;
+        v.cy = c.cy;
+        v.center = v.toWorld(QVector3D());
+        if (v.fx > 0 && v.fy > 0) views << v;
+    }
+    f.unmap(const_cast<uchar *>(data));
+
+    std::sort(views.begin(), views.end(), [](const ColmapView &a, const ColmapView &b) { return a.imageId < b.imageId; });
+    return views;
+}
+
+QHash<QString, double> ColmapModel::registeredImageErrors(const QString &sparseFolder, QString *error)
+{
+    QHash<QString, double> errors;
+    const QVector<ColmapView> views = loadViews(sparseFolder, error);
+    if (views.isEmpty()) return errors;
+
+    QFile f(QDir(sparseFolder).filePath("points3D.bin"));
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return errors;
+    }
+    const qint64 size = f.size();
+    const uchar *data = size >= 8 ? f.map(0, size) : nullptr;
+    if (!data) {
+        if (error) *error = "Could not map " + f.fileName();
+        return errors;
+    }
+
+    // Per point: id u64, xyz 3*f64, rgb 3*u8, error f64, track length u64,
+    // then track length * (image_id u32, point2D_idx u32). COLMAP keeps one
+    // error per point, so an image's error is the mean over its points.
+    QHash<quint32, QPair<double, int>> sums;
+    sums.reserve(views.size());
+    const quint64 count = readLE<quint64>(data);
+    const qint64 fixed = 8 + 24 + 3 + 8 + 8;
+    qint64 pos = 8;
+    for (quint64 i = 0; i < count; ++i) {
+        if (pos + fixed > size) break;
+        const uchar *p = data + pos;
+        const double e = readLE<double>(p + 35);
+        const quint64 trackLength = readLE<quint64>(p + 43);
+        qint64 next = pos + fixed;
+        if (!skipRecords(next, trackLength, 8, size)) break;
+        for (quint64 t = 0; t < trackLength; ++t) {
+            QPair<double, int> &s = sums[readLE<quint32>(p + fixed + t * 8)];
+            s.first += e;
+            ++s.second;
+        }
+        pos = next;
+    }
+    f.unmap(const_cast<uchar *>(data));
+
+    for (const ColmapView &v : views) {
+        const QPair<double, int> s = sums.value(v.imageId);
+        errors.insert(QFileInfo(v.name).fileName(), s.second > 0 ? s.first / s.second : qQNaN());
+    }
+    return errors;
+}
+
+bool ColmapModel::skipRecords(qint64 &pos, quint64 count, qint64 recordSize, qint64 size)
+{
+    if (pos < 0 || pos > size || count > quint64(size - pos) / quint64(recordSize)) return false;
+    pos += qint64(count) * recordSize;
+    return true;
+}
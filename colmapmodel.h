@@ -0,0 +1,56 @@
+#ifndef COLMAPMODEL_H
+#define COLMAPMODEL_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QVector3D>
+#include <QQuaternion>
+
+// One registered image of a COLMAP sparse model: its pose and intrinsics
+struct ColmapView
+{
+    quint32 imageId = 0;
+    QString name;
+    QQuaternion rotation;       // world -> camera
+    QVector3D translation;      // world -> camera
+    QVector3D center;           // camera centre in world coordinates
+    int width = 0;
+    int height = 0;
+    double fx = 0.0, fy = 0.0;  // pixels
+    double cx = 0.0, cy = 0.0;
+
+    // Point given in camera coordinates, in world coordinates
+    QVector3D toWorld(const QVector3D &cameraPoint) const
+    {
+        return rotation.conjugated().rotatedVector(cameraPoint - translation);
+    }
+
+    // Image corners at the given depth in front of the camera, world
+    // coordinates, clockwise from top-left
+    QVector<QVector3D> frustumCorners(float depth) const;
+};
+
+// Reader for the camera side of a COLMAP sparse model (cameras.bin and
+// images.bin). images.bin also stores every 2D keypoint, which is most of
+// the file on large projects, so the file is mapped and the keypoint
+// arrays are skipped rather than read.
+class ColmapModel
+{
+public:
+    // Views of sparse/N, ordered by image_id
+    static QVector<ColmapView> loadViews(const QString &sparseFolder, QString *error = nullptr);
+
+    // Registered images of sparse/N by file name, each with the mean
+    // reprojection error of the 3D points it observes (NaN if it observes
+    // none). Only images.bin and points3D.bin are read.
+    static QHash<QString, double> registeredImageErrors(const QString &sparseFolder, QString *error = nullptr);
+
+    // Moves pos past count records of recordSize bytes in a .bin file of
+    // size bytes. Returns false, leaving pos alone, when they would run past
+    // the end; the count is checked before it is multiplied, so a corrupt
+    // one cannot overflow pos.
+    static bool skipRecords(qint64 &pos, quint64 count, qint64 recordSize, qint64 size);
+};
+
+#endif // COLMAPMODEL_H
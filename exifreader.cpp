@@ -0,0 +1,207 @@
+#include "exifreader.h"
+
+#include <QFile>
+#include <QByteArray>
+#include <QImageReader>
+
+namespace
+{
+    // EXIF tags we care about
+    enum Tag : quint16 {
+        TagMake = 0x010F,
+        TagModel = 0x0110,
+        TagDateTime = 0x0132,
+        TagExifIfd = 0x8769,
+        TagGpsIfd = 0x8825,
+        TagDateTimeOriginal = 0x9003,
+        TagFocalLength = 0x920A,
+        TagPixelXDimension = 0xA002,
+        TagFocalPlaneXResolution = 0xA20E,
+        TagFocalPlaneResolutionUnit = 0xA210,
+        TagFocalLength35mm = 0xA405,
+    };
+
+    // Tags inside the GPS IFD (their numbers overlap the main IFD's)
+    enum GpsTag : quint16 { GpsLatitudeRef = 1, GpsLatitude = 2, GpsLongitudeRef = 3, GpsLongitude = 4 };
+
+    enum Type : quint16 { TypeAscii = 2, TypeShort = 3, TypeLong = 4, TypeRational = 5 };
+
+    // Bounds-checked reader over the TIFF block inside APP1
+    class Tiff
+    {
+    public:
+        explicit Tiff(const QByteArray &d) : data(d)
+        {
+            bigEndian = data.startsWith("MM");
+        }
+
+        bool valid() const
+        {
+            return data.size() >= 8 && (data.startsWith("II") || data.startsWith("MM")) && u16(2) == 42;
+        }
+
+        quint16 u16(int off) const
+        {
+            if (off < 0 || off + 2 > data.size()) return 0;
+            const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + off;
+            return bigEndian ? quint16(p[0] << 8 | p[1]) : quint16(p[1] << 8 | p[0]);
+        }
+
+        quint32 u32(int off) const
+        {
+            if (off < 0 || off + 4 > data.size()) return 0;
+            const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + off;
+            return bigEndian ? quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | p[3]
+                             : quint32(p[3]) << 24 | quint32(p[2]) << 16 | quint32(p[1]) << 8 | p[0];
+        }
+
+        // Offset of the value of an IFD entry (inline if it fits in 4 bytes)
+        int valueOffset(int entry, int size) const
+        {
+            return size <= 4 ? entry + 8 : int(u32(entry + 8));
+        }
+
+        double number(int entry) const
+        {
+            const quint16 type = u16(entry + 2);
+            if (type == TypeShort) return u16(entry + 8);
+            if (type == TypeLong) return u32(entry + 8);
+            if (type == TypeRational) {
+                const int off = int(u32(entry + 8));
+                const quint32 den = u32(off + 4);
+                return den ? double(u32(off)) / den : 0.0;
+            }
+            return 0.0;
+        }
+
+        // Degrees, minutes, seconds as three rationals. Cameras without a
+        // fix write 0/0, so a zero denominator means no position, not 0.
+        double degrees(int entry) const
+        {
+            if (u16(entry + 2) != TypeRational || u32(entry + 4) < 3) return qQNaN();
+            const int off = int(u32(entry + 8));
+            double value = 0.0, scale = 1.0;
+            for (int k = 0; k < 3; ++k, scale *= 60.0) {
+                const quint32 den = u32(off + k * 8 + 4);
+                if (!den) return qQNaN();
+                value += double(u32(off + k * 8)) / den / scale;
+            }
+            return value;
+        }
+
+        QString text(int entry) const
+        {
+            if (u16(entry + 2) != TypeAscii) return QString();
+            const int count = int(u32(entry + 4));
+            const int off = valueOffset(entry, count);
+            if (off < 0 || off + count > data.size()) return QString();
+            return QString::fromLatin1(data.constData() + off, count).remove(QChar('\0')).trimmed();
+        }
+
+        QByteArray data;
+        bool bigEndian = false;
+    };
+
+    QByteArray findExifBlock(QFile &f)
+    {
+        // EXIF sits in the first APP1 segment, well inside the first 128 KiB
+        const QByteArray head = f.read(128 * 1024);
+        if (head.size() < 4 || uchar(head[0]) != 0xFF || uchar(head[1]) != 0xD8)
+            return QByteArray();
+
+        int pos = 2;
+        while (pos + 4 <= head.size()) {
+            if (uchar(head[pos]) != 0xFF) break;
+            const uchar marker = uchar(head[pos + 1]);
+            const int length = uchar(head[pos + 2]) << 8 | uchar(head[pos + 3]);
+            if (marker == 0xDA || length < 2) break;   // start of scan: no more metadata
+            if (marker == 0xE1 && head.mid(pos + 4, 6) == QByteArray("Exif\0\0", 6))
+                return head.mid(pos + 10, length - 8);
+            pos += 2 + length;
+        }
+        return QByteArray();
+    }
+}
+
+double ExifInfo::focalPixels() const
+{
+    const int longSide = qMax(width, height);
+    if (longSide <= 0) return 0.0;
+    if (focalMm > 0 && sensorWidthMm > 0)
+        return focalMm * longSide / sensorWidthMm;
+    if (focal35mm > 0)
+        return focal35mm * longSide / 36.0;
+    return 0.0;
+}
+
+ExifInfo ExifReader::read(const QString &path)
+{
+    ExifInfo info;
+
+    const QSize size = QImageReader(path).size();   // header only
+    info.width = size.width();
+    info.height = size.height();
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return info;
+    const Tiff tiff(findExifBlock(f));
+    if (!tiff.valid()) return info;
+
+    double pixelX = 0.0, planeXRes = 0.0, planeUnit = 2.0;   // unit 2 = inch (EXIF default)
+    int exifIfd = 0, gpsIfd = 0;
+    QString dateTime, dateTimeOriginal;
+
+    auto walk = [&](int ifd) {
+        const int count = tiff.u16(ifd);
+        for (int i = 0; i < count && i < 512; ++i) {
+            const int entry = ifd + 2 + i * 12;
+            switch (tiff.u16(entry)) {
+            case TagMake:                     info.make = tiff.text(entry); break;
+            case TagModel:                    info.model = tiff.text(entry); break;
+            case TagDateTime:                 dateTime = tiff.text(entry); break;
+            case TagExifIfd:                  exifIfd = int(tiff.u32(entry + 8)); break;
+            case TagGpsIfd:                   gpsIfd = int(tiff.u32(entry + 8)); break;
+            case TagDateTimeOriginal:         dateTimeOriginal = tiff.text(entry); break;
+            case TagFocalLength:              info.focalMm = tiff.number(entry); break;
+            case TagFocalLength35mm:          info.focal35mm = tiff.number(entry); break;
+            case TagPixelXDimension:          pixelX = tiff.number(entry); break;
+            case TagFocalPlaneXResolution:    planeXRes = tiff.number(entry); break;
+            case TagFocalPlaneResolutionUnit: planeUnit = tiff.number(entry); break;
+            }
+        }
+    };
+
+    walk(int(tiff.u32(4)));
+    if (exifIfd > 0) walk(exifIfd);
+
+    // "YYYY:MM:DD HH:MM:SS" on the camera's clock; no time zone is recorded
+    info.captureTime = QDateTime::fromString(dateTimeOriginal.isEmpty() ? dateTime : dateTimeOriginal,
+                                             "yyyy:MM:dd HH:mm:ss");
+
+    if (gpsIfd > 0) {
+        QString latRef, lonRef;
+        double lat = qQNaN(), lon = qQNaN();
+        const int count = tiff.u16(gpsIfd);
+        for (int i = 0; i < count && i < 64; ++i) {
+            const int entry = gpsIfd + 2 + i * 12;
+            switch (tiff.u16(entry)) {
+            case GpsLatitudeRef:  latRef = tiff.text(entry); break;
+            case GpsLatitude:     lat = tiff.degrees(entry); break;
+            case GpsLongitudeRef: lonRef = tiff.text(entry); break;
+            case GpsLongitude:    lon = tiff.degrees(entry); break;
+            }
+        }
+        info.latitude = latRef == "S" ? -lat : lat;
+        info.longitude = lonRef == "W" ? -lon : lon;
+    }
+
+    // Sensor width from the focal plane resolution, else from the 35 mm equivalent
+    if (planeXRes > 0) {
+        const double mmPerUnit = planeUnit == 3 ? 10.0 : planeUnit == 4 ? 1.0 : 25.4;
+        const double across = pixelX > 0 ? pixelX : qMax(info.width, info.height);
+        info.sensorWidthMm = across / planeXRes * mmPerUnit;
+    } else if (info.focalMm > 0 && info.focal35mm > 0) {
+        info.sensorWidthMm = 36.0 * info.focalMm / info.focal35mm;
+    }
+    return info;
+}
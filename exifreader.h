@@ -0,0 +1,38 @@
+#ifndef EXIFREADER_H
+#define EXIFREADER_H
+
+#include <QString>
+#include <QDateTime>
+#include <QtNumeric>
+
+// The few EXIF fields that matter for camera intrinsics
+struct ExifInfo
+{
+    QString make;
+    QString model;
+    int width = 0;                 // pixels, from the image header
+    int height = 0;
+    double focalMm = 0.0;          // FocalLength
+    double focal35mm = 0.0;        // FocalLengthIn35mmFilm
+    double sensorWidthMm = 0.0;    // along the long side, derived, 0 if unknown
+    QDateTime captureTime;         // DateTimeOriginal, camera clock, invalid if missing
+    double latitude = qQNaN();     // GPS, degrees, NaN if missing
+    double longitude = qQNaN();
+
+    bool hasExif() const { return !make.isEmpty() || !model.isEmpty() || focalMm > 0; }
+    bool hasGps() const { return !qIsNaN(latitude) && !qIsNaN(longitude); }
+
+    // Focal length in pixels for the long side, 0 if it cannot be derived
+    double focalPixels() const;
+};
+
+// Minimal JPEG/EXIF reader. Only the APP1 segment and the image header are
+// read, never the pixel data, so it is cheap enough to run on every image
+// at ingest.
+class ExifReader
+{
+public:
+    static ExifInfo read(const QString &path);
+};
+
+#endif // EXIFREADER_H
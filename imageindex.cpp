@@ -0,0 +1,716 @@
+#include "imageindex.h"
+
+#include <QRegularExpression>
+#include <QTime>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int kSharpnessWidth = 160;
+    const qint64 kNoTime = std::numeric_limits<qint64>::min();
+
+    // "14", "14:00", "9:30"
+    bool parseClock(const QString &text, int *minutes)
+    {
+        const QTime t = QTime::fromString(text.contains(':') ? text : text + ":00", "H:mm");
+        if (!t.isValid()) return false;
+        *minutes = t.hour() * 60 + t.minute();
+        return true;
+    }
+
+    double distanceKm(double lat1, double lon1, double lat2, double lon2)
+    {
+        const double rad = 3.14159265358979323846 / 180.0;
+        const double dLat = (lat2 - lat1) * rad, dLon = (lon2 - lon1) * rad;
+        const double a = std::sin(dLat / 2) * std::sin(dLat / 2)
+                         + std::cos(lat1 * rad) * std::cos(lat2 * rad) * std::sin(dLon / 2) * std::sin(dLon / 2);
+        return 6371.0 * 2.0 * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+    }
+}
+
+bool ImageQuery::isEmpty() const
+{
+    const ImageQuery none;
+    return nameContains.isEmpty() && cameraGroups.isEmpty() && registration == AnyRegistration
+           && fromMinute < 0 && toMinute < 0 && since == none.since && until == none.until
+           && minSharpness == none.minSharpness && maxSharpness == none.maxSharpness
+           && minError == none.minError && maxError == none.maxError && minMegapixels <= 0.0f
+           && maxMegapixels == none.maxMegapixels
+           && gps < 0 && nearKm <= 0.0 && sortKey == Unsorted;
+}
+
+QString ImageQuery::syntaxHelp()
+{
+    return "Words filter the file name. Terms:\n"
+           "  camera:B  camera:A,C      camera group\n"
+           "  registered  unregistered  in the sparse model or not\n"
+           "  after:14:00  before:16:30 time of day taken\n"
+           "  since:2024-05-01  until:2024-05-02\n"
+           "  sharp>150  err<1.5  mp>=12  mp<24\n"
+           "  gps  nogps  near:lat,lon,km\n"
+           "  sort:name|time|camera|resolution|sharp|blur|error  desc  asc";
+}
+
+ImageQuery ImageQuery::parse(const QString &text, QString *error)
+{
+    ImageQuery q;
+    error->clear();
+    static const QRegularExpression compare("^(sharp|sharpness|err|error|mp|megapixels)(<=|>=|<|>|=)(-?[0-9.]+)$");
+
+    const QStringList words = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    for (const QString &word : words) {
+        const QString w = word.toLower();
+        const int colon = w.indexOf(':');
+        const QString key = colon > 0 ? w.left(colon) : w;
+        const QString value = colon > 0 ? word.mid(colon + 1) : QString();
+
+        if (w == "registered") {
+            q.registration = RegisteredOnly;
+        } else if (w == "unregistered") {
+            q.registration = UnregisteredOnly;
+        } else if (w == "gps") {
+            q.gps = 1;
+        } else if (w == "nogps") {
+            q.gps = 0;
+        } else if (w == "desc") {
+            q.direction = -1;
+        } else if (w == "asc") {
+            q.direction = 1;
+        } else if (key == "camera" || key == "cam") {
+            for (const QString &g : value.split(',', Qt::SkipEmptyParts))
+                q.cameraGroups << g.toUpper();
+        } else if (key == "after" || key == "before") {
+            if (!parseClock(value, key == "after" ? &q.fromMinute : &q.toMinute)) {
+                *error = "Not a time of day: " + value;
+                return q;
+            }
+        } else if (key == "since" || key == "until") {
+            const QDate d = QDate::fromString(value, Qt::ISODate);
+            if (!d.isValid()) {
+                *error = "Not a date (YYYY-MM-DD): " + value;
+                return q;
+            }
+            // Capture times are camera clock, stored as if UTC
+            const qint64 ms = QDateTime(d, QTime(0, 0), Qt::UTC).toMSecsSinceEpoch();
+            if (key == "since") q.since = ms;
+            else q.until = ms + 24 * 3600 * 1000;
+        } else if (key == "near") {
+            const QStringList v = value.split(',');
+            bool ok[3] = {};
+            if (v.size() == 3) {
+                q.nearLatitude = v[0].toDouble(&ok[0]);
+                q.nearLongitude = v[1].toDouble(&ok[1]);
+                q.nearKm = v[2].toDouble(&ok[2]);
+            }
+            if (!ok[0] || !ok[1] || !ok[2] || q.nearKm <= 0) {
+                *error = "Expected near:lat,lon,km";
+                return q;
+            }
+        } else if (key == "sort") {
+            QString k = value.toLower();
+            if (k.startsWith('-')) {
+                q.direction = -1;
+                k = k.mid(1);
+            }
+            q.defaultDescending = false;
+            if (k == "name") q.sortKey = ByName;
+            else if (k == "time" || k == "date") q.sortKey = ByTime;
+            else if (k == "camera") q.sortKey = ByCamera;
+            else if (k == "resolution" || k == "mp") q.sortKey = ByResolution;
+            else if (k == "error" || k == "err") q.sortKey = ByError;
+            else if (k == "sharp" || k == "sharpness") {
+                q.sortKey = BySharpness;
+                q.defaultDescending = true;      // sharpest first
+            } else if (k == "blur") {
+                q.sortKey = BySharpness;         // blurriest first
+            } else {
+                *error = "Unknown sort key: " + value;
+                return q;
+            }
+        } else if (const QRegularExpressionMatch m = compare.match(w); m.hasMatch()) {
+            bool ok = false;
+            const float v = m.captured(3).toFloat(&ok);
+            if (!ok) {
+                *error = "Not a number: " + m.captured(3);
+                return q;
+            }
+            const QString field = m.captured(1), op = m.captured(2);
+            float *lo = field.startsWith("sharp") ? &q.minSharpness : field.startsWith("err") ? &q.minError : &q.minMegapixels;
+            float *hi = field.startsWith("sharp") ? &q.maxSharpness : field.startsWith("err") ? &q.maxError : &q.maxMegapixels;
+            // Bounds are inclusive; a strict one moves to the next float past the value
+            const float inf = std::numeric_limits<float>::infinity();
+            if (op == ">") *lo = std::nextafter(v, inf);
+            else if (op == ">=" || op == "=") *lo = v;
+            if (op == "<") *hi = std::nextafter(v, -inf);
+            else if (op == "<=" || op == "=") *hi = v;
+        } else {
+            q.nameContains << word;
+        }
+    }
+    return q;
+}
+
+float ImageIndex::sharpness(const QImage &image)
+{
+    if (image.isNull()) return -1.0f;
+    QImage gray = image.width() > kSharpnessWidth ? image.scaledToWidth(kSharpnessWidth, Qt::SmoothTransformation) : image;
+    gray = gray.convertToFormat(QImage::Format_Grayscale8);
+    const int w = gray.width(), h = gray.height();
+    if (w < 3 || h < 3) return -1.0f;
+
+    double sum = 0.0, sum2 = 0.0;
+    for (int y = 1; y < h - 1; ++y) {
+        const uchar *up = gray.constScanLine(y - 1), *row = gray.constScanLine(y), *down = gray.constScanLine(y + 1);
+        for (int x = 1; x < w - 1; ++x) {
+            const double lap = up[x] + down[x] + row[x - 1] + row[x + 1] - 4.0 * row[x];
+            sum += lap;
+            sum2 += lap * lap;
+        }
+    }
+    const double n = double(w - 2) * (h - 2);
+    const double mean = sum / n;
+    return float(sum2 / n - mean * mean);
+}
+
+void ImageIndex::clear()
+{
+    const int next = generationCount + 1;
+    *this = ImageIndex();
+    generationCount = next;
+}
+
+void ImageIndex::changed()
+{
+    for (bool &valid : orderValid) valid = false;
+    secondaryValid = false;
+}
+
+void ImageIndex::insert(const ImageRecord &r)
+{
+    remove(r.name);
+
+    const int row = names.size();
+    rowByName.insert(r.name, row);
+    names << r.name;
+    alive << 1;
+    if (r.captureTime.isValid()) {
+        // The camera clock has no zone; keep its wall time as if UTC
+        times << QDateTime(r.captureTime.date(), r.captureTime.time(), Qt::UTC).toMSecsSinceEpoch();
+        minutes << qint16(r.captureTime.time().hour() * 60 + r.captureTime.time().minute());
+    } else {
+        times << kNoTime;
+        minutes << qint16(-1);
+    }
+    cameras << 0;
+    sizes << QSize(r.width, r.height);
+    megapixels << float(double(r.width) * r.height / 1e6);
+    sharpnesses << r.sharpness;
+    errors << qQNaN();
+    latitudes << r.latitude;
+    longitudes << r.longitude;
+    registered << 0;
+    setCameraGroup(r.name, r.cameraGroup);
+    changed();
+}
+
+void ImageIndex::remove(const QString &name)
+{
+    const int row = rowByName.value(name, -1);
+    if (row < 0) return;
+    rowByName.remove(name);
+    alive[row] = 0;
+    changed();
+
+    // Dead rows only cost scan time; drop them once they are the majority
+    if (names.size() > 1024 && rowByName.size() < names.size() / 2)
+        compact();
+}
+
+void ImageIndex::compact()
+{
+    ImageIndex live;
+    live.cameraNames = cameraNames;
+    for (int row = 0; row < names.size(); ++row) {
+        if (!alive[row]) continue;
+        live.rowByName.insert(names[row], live.names.size());
+        live.names << names[row];
+        live.alive << 1;
+        live.times << times[row];
+        live.minutes << minutes[row];
+        live.cameras << cameras[row];
+        live.sizes << sizes[row];
+        live.megapixels << megapixels[row];
+        live.sharpnesses << sharpnesses[row];
+        live.errors << errors[row];
+        live.latitudes << latitudes[row];
+        live.longitudes << longitudes[row];
+        live.registered << registered[row];
+    }
+    live.generationCount = generationCount + 1;
+    *this = live;
+}
+
+void ImageIndex::setCameraGroup(const QString &name, const QString &group)
+{
+    const int row = rowByName.value(name, -1);
+    if (row < 0) return;
+    int code = cameraNames.indexOf(group);
+    if (code < 0) {
+        code = cameraNames.size();
+        cameraNames << group;
+    }
+    if (cameras[row] == code) return;
+    cameras[row] = quint16(code);
+    orderValid[CameraCol] = false;
+    secondaryValid = false;
+}
+
+void ImageIndex::setRegistration(const QHash<QString, double> &registeredErrors)
+{
+    for (int row = 0; row < names.size(); ++row) {
+        const auto it = registeredErrors.constFind(names[row]);
+        registered[row] = it != registeredErrors.constEnd();
+        errors[row] = registered[row] ? float(it.value()) : qQNaN();
+    }
+    orderValid[ErrorCol] = false;
+    secondaryValid = false;
+}
+
+ImageRecord ImageIndex::record(const QString &name) const
+{
+    ImageRecord r;
+    const int row = rowOf(name);
+    if (row < 0) return r;
+    r.name = name;
+    r.cameraGroup = cameraNames.value(cameras[row]);
+    if (times[row] != kNoTime)
+        r.captureTime = QDateTime::fromMSecsSinceEpoch(times[row], Qt::UTC);
+    r.latitude = latitudes[row];
+    r.longitude = longitudes[row];
+    r.width = sizes[row].width();
+    r.height = sizes[row].height();
+    r.sharpness = sharpnesses[row];
+    return r;
+}
+
+bool ImageIndex::hasValue(int column, int row) const
+{
+    switch (column) {
+    case NameCol:      return true;
+    case TimeCol:      return times[row] != kNoTime;
+    case MinuteCol:    return minutes[row] >= 0;
+    case CameraCol:    return cameras[row] != 0;
+    case MegapixelCol: return megapixels[row] > 0.0f;
+    case SharpnessCol: return sharpnesses[row] >= 0.0f;
+    case ErrorCol:     return !qIsNaN(errors[row]);
+    case LatitudeCol:  return !qIsNaN(latitudes[row]);
+    }
+    return false;
+}
+
+double ImageIndex::key(int column, int row) const
+{
+    switch (column) {
+    case TimeCol:      return double(times[row]);
+    case MinuteCol:    return minutes[row];
+    case MegapixelCol: return megapixels[row];
+    case SharpnessCol: return sharpnesses[row];
+    case ErrorCol:     return errors[row];
+    case LatitudeCol:  return latitudes[row];
+    }
+    return 0.0;
+}
+
+bool ImageIndex::less(int column, int a, int b) const
+{
+    int c = 0;
+    if (column == NameCol)
+        c = names[a].compare(names[b], Qt::CaseInsensitive);
+    else if (column == CameraCol)
+        c = cameraNames[cameras[a]].compare(cameraNames[cameras[b]]);
+    else
+        c = key(column, a) < key(column, b) ? -1 : (key(column, b) < key(column, a) ? 1 : 0);
+    return c != 0 ? c < 0 : a < b;   // ties keep ingest order
+}
+
+// Live rows with a value in this column, in ascending order
+const QVector<int> &ImageIndex::sorted(int column) const
+{
+    QVector<int> &rows = order[column];
+    if (orderValid[column]) return rows;
+
+    rows.clear();
+    rows.reserve(rowByName.size());
+    for (int row = 0; row < names.size(); ++row)
+        if (alive[row] && hasValue(column, row)) rows << row;
+    std::sort(rows.begin(), rows.end(), [this, column](int a, int b) { return less(column, a, b); });
+    orderValid[column] = true;
+    return rows;
+}
+
+// Rows with from <= value < to, as a slice of the sorted index
+QPair<const int *, const int *> ImageIndex::range(int column, double from, double to) const
+{
+    const QVector<int> &rows = sorted(column);
+    auto below = [this, column](int row, double v) { return key(column, row) < v; };
+    const int *begin = std::lower_bound(rows.constData(), rows.constData() + rows.size(), from, below);
+    const int *end = std::lower_bound(begin, rows.constData() + rows.size(), to, below);
+    return { begin, end };
+}
+
+void ImageIndex::buildSecondary() const
+{
+    if (secondaryValid) return;
+    rowsByCamera = QVector<QVector<int>>(cameraNames.size());
+    rowsByRegistration[0].clear();
+    rowsByRegistration[1].clear();
+    for (int row = 0; row < names.size(); ++row) {
+        if (!alive[row]) continue;
+        rowsByCamera[cameras[row]] << row;
+        rowsByRegistration[registered[row]] << row;
+    }
+    secondaryValid = true;
+}
+
+bool ImageIndex::matches(const ImageQuery &q, int row) const
+{
+    if (!alive[row]) return false;
+    for (const QString &word : q.nameContains)
+        if (!names[row].contains(word, Qt::CaseInsensitive)) return false;
+    if (!q.cameraGroups.isEmpty() && !q.cameraGroups.contains(cameraNames[cameras[row]].toUpper()))
+        return false;
+    if (q.registration == ImageQuery::RegisteredOnly && !registered[row]) return false;
+    if (q.registration == ImageQuery::UnregisteredOnly && registered[row]) return false;
+
+    if (q.fromMinute >= 0 || q.toMinute >= 0) {
+        const int m = minutes[row];
+        if (m < 0) return false;
+        const int from = q.fromMinute >= 0 ? q.fromMinute : 0;
+        const int to = q.toMinute >= 0 ? q.toMinute : 24 * 60;
+        // after:22:00 before:02:00 wraps past midnight
+        if (from <= to ? (m < from || m >= to) : (m < from && m >= to)) return false;
+    }
+    if (q.since != std::numeric_limits<qint64>::min() || q.until != std::numeric_limits<qint64>::max()) {
+        if (times[row] == kNoTime || times[row] < q.since || times[row] >= q.until) return false;
+    }
+    if (q.minSharpness > -std::numeric_limits<float>::infinity() || q.maxSharpness < std::numeric_limits<float>::infinity()) {
+        if (sharpnesses[row] < 0.0f || sharpnesses[row] < q.minSharpness || sharpnesses[row] > q.maxSharpness) return false;
+    }
+    if (q.minError > -std::numeric_limits<float>::infinity() || q.maxError < std::numeric_limits<float>::infinity()) {
+        if (qIsNaN(errors[row]) || errors[row] < q.minError || errors[row] > q.maxError) return false;
+    }
+    if (megapixels[row] < q.minMegapixels) return false;
+    if (q.maxMegapixels < std::numeric_limits<float>::infinity()
+        && (megapixels[row] <= 0.0f || megapixels[row] > q.maxMegapixels)) {
+        return false;   // an unknown size is not below any bound
+    }
+
+    const bool hasGps = !qIsNaN(latitudes[row]) && !qIsNaN(longitudes[row]);
+    if (q.gps >= 0 && hasGps != (q.gps == 1)) return false;
+    if (q.nearKm > 0.0
+        && (!hasGps || distanceKm(q.nearLatitude, q.nearLongitude, latitudes[row], longitudes[row]) > q.nearKm)) {
+        return false;
+    }
+    return true;
+}
+
+QVector<int> ImageIndex::run(const ImageQuery &q) const
+{
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // Start from the indexed filter with the fewest candidates
+    const int *begin = nullptr, *end = nullptr;
+    int best = rowByName.size();
+    auto consider = [&](const int *b, const int *e) {
+        if (e - b < best) {
+            best = int(e - b);
+            begin = b;
+            end = e;
+        }
+    };
+
+    buildSecondary();
+    QVector<int> cameraRows;
+    if (!q.cameraGroups.isEmpty()) {
+        for (int code = 1; code < cameraNames.size(); ++code)
+            if (q.cameraGroups.contains(cameraNames[code].toUpper())) cameraRows += rowsByCamera[code];
+        consider(cameraRows.constData(), cameraRows.constData() + cameraRows.size());
+    }
+    if (q.registration != ImageQuery::AnyRegistration) {
+        const QVector<int> &rows = rowsByRegistration[q.registration == ImageQuery::RegisteredOnly ? 1 : 0];
+        consider(rows.constData(), rows.constData() + rows.size());
+    }
+    const bool wraps = q.fromMinute >= 0 && q.toMinute >= 0 && q.fromMinute > q.toMinute;
+    if ((q.fromMinute >= 0 || q.toMinute >= 0) && !wraps) {
+        const auto r = range(MinuteCol, qMax(0, q.fromMinute), q.toMinute >= 0 ? q.toMinute : 24 * 60);
+        consider(r.first, r.second);
+    }
+    if (q.since != std::numeric_limits<qint64>::min() || q.until != std::numeric_limits<qint64>::max()) {
+        const auto r = range(TimeCol, double(q.since), double(q.until));
+        consider(r.first, r.second);
+    }
+    if (q.minSharpness > -inf || q.maxSharpness < inf) {
+        const auto r = range(SharpnessCol, q.minSharpness, std::nextafter(q.maxSharpness, inf));
+        consider(r.first, r.second);
+    }
+    if (q.minError > -inf || q.maxError < inf) {
+        const auto r = range(ErrorCol, q.minError, std::nextafter(q.maxError, inf));
+        consider(r.first, r.second);
+    }
+    if (q.minMegapixels > 0.0f || q.maxMegapixels < inf) {
+        const auto r = range(MegapixelCol, q.minMegapixels, std::nextafter(q.maxMegapixels, inf));
+        consider(r.first, r.second);
+    }
+    if (q.nearKm > 0.0) {
+        const double degrees = q.nearKm / 111.2;   // one degree of latitude
+        const auto r = range(LatitudeCol, q.nearLatitude - degrees, q.nearLatitude + degrees);
+        consider(r.first, r.second);
+    }
+
+    QVector<int> rows;
+    if (begin) {
+        rows.reserve(best);
+        for (const int *it = begin; it != end; ++it)
+            if (matches(q, *it)) rows << *it;
+    } else {
+        rows.reserve(rowByName.size());
+        for (int row = 0; row < names.size(); ++row)
+            if (matches(q, row)) rows << row;
+    }
+
+    static const int sortColumns[] = { NameCol, TimeCol, CameraCol, MegapixelCol, SharpnessCol, ErrorCol };
+    if (q.sortKey < 0 || q.sortKey >= int(sizeof(sortColumns) / sizeof(sortColumns[0]))) {
+        std::sort(rows.begin(), rows.end());   // ingest order
+        return rows;
+    }
+
+    // Order comes from the sort column's index; rows without a value go last
+    const int column = sortColumns[q.sortKey];
+    const QVector<int> &ord = sorted(column);
+    QVector<int> result;
+    result.reserve(rows.size());
+    if (rows.size() > ord.size() / 8) {
+        QVector<quint8> hit(names.size(), 0);
+        for (int row : rows) hit[row] = 1;
+        for (int row : ord)
+            if (hit[row]) {
+                result << row;
+                hit[row] = 0;
+            }
+        const int known = result.size();
+        for (int row : rows)
+            if (hit[row]) result << row;
+        if (q.descending()) std::reverse(result.begin(), result.begin() + known);
+    } else {
+        QVector<int> known, unknown;
+        for (int row : rows) (hasValue(column, row) ? known : unknown) << row;
+        std::sort(known.begin(), known.end(), [this, column](int a, int b) { return less(column, a, b); });
+        if (q.descending()) std::reverse(known.begin(), known.end());
+        result = known + unknown;
+    }
+    return result;
+}
+
+ImageQueryProxy::ImageQueryProxy(const ImageIndex *index, QObject *parent)
+    : QAbstractProxyModel(parent), imageIndex(index)
+{
+}
+
+void ImageQueryProxy::setSourceModel(QAbstractItemModel *model)
+{
+    beginResetModel();
+    if (sourceModel())
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    QAbstractProxyModel::setSourceModel(model);
+    result.clear();
+    resultRowBySource.fill(-1, model ? model->rowCount() : 0);
+    generation = -1;
+
+    if (model) {
+        // The Image Manager's list is flat: only top level rows matter
+        connect(model, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &parent, int first, int last) {
+            if (!parent.isValid()) sourceInserted(first, last);
+        });
+        connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this](const QModelIndex &parent, int first, int last) {
+            if (!parent.isValid()) sourceAboutToBeRemoved(first, last);
+        });
+        connect(model, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &parent, int first, int last) {
+            if (!parent.isValid()) sourceRemoved(first, last);
+        });
+        connect(model, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+            sourceChanged(topLeft, bottomRight);
+        });
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { beginResetModel(); });
+        connect(model, &QAbstractItemModel::modelReset, this, [this]() { sourceReset(); });
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]() { beginResetModel(); });
+        connect(model, &QAbstractItemModel::layoutChanged, this, [this]() { sourceReset(); });
+    }
+    endResetModel();
+}
+
+// The only pass that reads every item: after the index renumbered its rows
+void ImageQueryProxy::rebuild()
+{
+    const QAbstractItemModel *source = sourceModel();
+    const int n = source ? source->rowCount() : 0;
+    sourceRowByIndexRow.fill(-1, imageIndex->size());
+    for (int s = 0; s < n; ++s) {
+        const int row = imageIndex->rowOf(source->index(s, 0).data(Qt::DisplayRole).toString());
+        if (row < 0) continue;
+        if (row >= sourceRowByIndexRow.size())
+            sourceRowByIndexRow.insert(sourceRowByIndexRow.size(), row + 1 - sourceRowByIndexRow.size(), -1);
+        sourceRowByIndexRow[row] = s;
+    }
+    generation = imageIndex->generation();
+}
+
+void ImageQueryProxy::setResult(const QVector<int> &rows)
+{
+    if (generation != imageIndex->generation())
+        rebuild();
+
+    beginResetModel();
+    for (int s : result)
+        resultRowBySource[s] = -1;
+    result.clear();
+    result.reserve(rows.size());
+    for (int row : rows) {
+        const int s = sourceRowByIndexRow.value(row, -1);
+        if (s < 0) continue;   // no tile yet; the query runs again once it is added
+        resultRowBySource[s] = result.size();
+        result << s;
+    }
+    endResetModel();
+}
+
+void ImageQueryProxy::sourceInserted(int first, int last)
+{
+    const int count = last - first + 1;
+    const bool appended = first == resultRowBySource.size();
+    resultRowBySource.insert(first, count, -1);
+    if (!appended) {
+        for (int k = 0; k < result.size(); ++k) {
+            if (result[k] >= first) result[k] += count;
+            resultRowBySource[result[k]] = k;
+        }
+    }
+
+    // New tiles are not in the current result; they only need their index row
+    if (generation != imageIndex->generation()) return;   // rebuilt before the next result
+    if (!appended) {
+        for (int &s : sourceRowByIndexRow)
+            if (s >= first) s += count;
+    }
+    for (int s = first; s <= last; ++s) {
+        const int row = imageIndex->rowOf(sourceModel()->index(s, 0).data(Qt::DisplayRole).toString());
+        if (row < 0) {
+            generation = -1;   // added to the list before the index; match everything later
+            return;
+        }
+        if (row >= sourceRowByIndexRow.size())
+            sourceRowByIndexRow.insert(sourceRowByIndexRow.size(), row + 1 - sourceRowByIndexRow.size(), -1);
+        sourceRowByIndexRow[row] = s;
+    }
+}
+
+// Tiles are deleted one at a time, which the view gets as one row removal;
+// anything larger resets it
+void ImageQueryProxy::sourceAboutToBeRemoved(int first, int last)
+{
+    int shown = -1, count = 0;
+    for (int s = first; s <= last && s < resultRowBySource.size(); ++s) {
+        if (resultRowBySource[s] < 0) continue;
+        shown = resultRowBySource[s];
+        ++count;
+    }
+    removal = count == 0 ? NoRemoval : count == 1 ? RemovingRow : Resetting;
+    if (removal == RemovingRow)
+        beginRemoveRows(QModelIndex(), shown, shown);
+    else if (removal == Resetting)
+        beginResetModel();
+}
+
+void ImageQueryProxy::sourceRemoved(int first, int last)
+{
+    const int count = last - first + 1;
+    resultRowBySource.remove(first, qMin(count, resultRowBySource.size() - first));
+    int kept = 0;
+    for (int k = 0; k < result.size(); ++k) {
+        const int s = result[k];
+        if (s >= first && s <= last) continue;
+        result[kept] = s > last ? s - count : s;
+        resultRowBySource[result[kept]] = kept;
+        ++kept;
+    }
+    result.resize(kept);
+
+    for (int &s : sourceRowByIndexRow) {
+        if (s > last) s -= count;
+        else if (s >= first) s = -1;
+    }
+
+    if (removal == RemovingRow)
+        endRemoveRows();
+    else if (removal == Resetting)
+        endResetModel();
+    removal = NoRemoval;
+}
+
+// Thumbnails are set after the tiles exist; repaint the ones shown
+void ImageQueryProxy::sourceChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (topLeft.parent().isValid()) return;
+    for (int s = topLeft.row(); s <= bottomRight.row() && s < resultRowBySource.size(); ++s) {
+        const int k = resultRowBySource[s];
+        if (k >= 0) emit dataChanged(index(k, 0), index(k, 0));
+    }
+}
+
+// Paired with the beginResetModel() of the source's about-to signal
+void ImageQueryProxy::sourceReset()
+{
+    result.clear();
+    resultRowBySource.fill(-1, sourceModel()->rowCount());
+    generation = -1;
+    endResetModel();
+}
+
+QModelIndex ImageQueryProxy::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= result.size() || column != 0) return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex ImageQueryProxy::parent(const QModelIndex &) const
+{
+    return QModelIndex();
+}
+
+int ImageQueryProxy::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : result.size();
+}
+
+int ImageQueryProxy::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+bool ImageQueryProxy::hasChildren(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !result.isEmpty();
+}
+
+QModelIndex ImageQueryProxy::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel() || proxyIndex.row() >= result.size()) return QModelIndex();
+    return sourceModel()->index(result[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex ImageQueryProxy::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.parent().isValid()) return QModelIndex();
+    const int k = resultRowBySource.value(sourceIndex.row(), -1);
+    return k < 0 ? QModelIndex() : createIndex(k, sourceIndex.column());
+}
@@ -0,0 +1,185 @@
+#ifndef IMAGEINDEX_H
+#define IMAGEINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QHash>
+#include <QPair>
+#include <QSize>
+#include <QVector>
+#include <QImage>
+#include <QAbstractProxyModel>
+#include <QtNumeric>
+#include <limits>
+
+// What the Image Manager knows about one image, gathered at ingest
+struct ImageRecord
+{
+    QString name;                  // file name, the key
+    QString cameraGroup;
+    QDateTime captureTime;         // invalid if unknown
+    double latitude = qQNaN();
+    double longitude = qQNaN();
+    int width = 0;
+    int height = 0;
+    float sharpness = -1.0f;       // ImageIndex::sharpness, < 0 if unknown
+};
+
+// A filter and sort over the index, usually parsed from the search box:
+//   unregistered camera:B after:14:00 sort:blur
+struct ImageQuery
+{
+    enum SortKey { Unsorted = -1, ByName, ByTime, ByCamera, ByResolution, BySharpness, ByError };
+    enum Registration { AnyRegistration, RegisteredOnly, UnregisteredOnly };
+
+    QStringList nameContains;      // every word must appear in the file name
+    QStringList cameraGroups;      // any of these
+    Registration registration = AnyRegistration;
+    int fromMinute = -1;           // time of day, minutes after midnight, -1 = open
+    int toMinute = -1;
+    qint64 since = std::numeric_limits<qint64>::min();   // capture time, ms since epoch
+    qint64 until = std::numeric_limits<qint64>::max();
+    float minSharpness = -std::numeric_limits<float>::infinity();
+    float maxSharpness = std::numeric_limits<float>::infinity();
+    float minError = -std::numeric_limits<float>::infinity();
+    float maxError = std::numeric_limits<float>::infinity();
+    float minMegapixels = 0.0f;
+    float maxMegapixels = std::numeric_limits<float>::infinity();
+    int gps = -1;                  // -1 any, 0 without, 1 with
+    double nearLatitude = 0.0;
+    double nearLongitude = 0.0;
+    double nearKm = 0.0;           // 0 = no distance filter
+    int sortKey = Unsorted;
+    int direction = 0;             // as typed: 1 asc, -1 desc, 0 = the sort key's default
+    bool defaultDescending = false;   // sort:sharp lists the sharpest first unless asc is given
+
+    bool isEmpty() const;
+    bool descending() const { return direction != 0 ? direction < 0 : defaultDescending; }
+
+    // Words of the search box; unknown words match the file name. On a
+    // malformed term *error is set and the returned query is not usable.
+    static ImageQuery parse(const QString &text, QString *error);
+    static QString syntaxHelp();
+};
+
+// Column store of ImageRecords with sorted and secondary indexes.
+//
+// Each field lives in its own array indexed by row, so a query only
+// touches the columns it filters on. Per column, a sorted order of the rows
+// that have a value is built on first use and kept until the next change.
+// Range filters (time of day, date, sharpness, error, resolution, position)
+// become binary searches in it. Camera group and registration keep row
+// lists per value. A query starts from whichever of these yields the fewest
+// candidates, checks the rest of its filters on the columns, and takes
+// its order from the sort column's index instead of sorting.
+class ImageIndex
+{
+public:
+    // Blur measure: variance of the Laplacian of the grey image, on a
+    // thumbnail scaled to a fixed width so ingest paths compare
+    static float sharpness(const QImage &image);
+
+    void clear();
+    void insert(const ImageRecord &record);   // replaces a record with the same name
+    void remove(const QString &name);
+    void setCameraGroup(const QString &name, const QString &group);
+
+    // Images in the hash are registered, with their mean reprojection
+    // error (may be NaN); every other image is unregistered
+    void setRegistration(const QHash<QString, double> &registeredErrors);
+
+    int size() const { return rowByName.size(); }
+    int rowOf(const QString &name) const { return rowByName.value(name, -1); }
+    // Changes whenever rows are renumbered (clear, compaction); row numbers
+    // taken before that no longer mean the same images
+    int generation() const { return generationCount; }
+    ImageRecord record(const QString &name) const;
+
+    // Rows matching the query, in result order (see rowOf)
+    QVector<int> run(const ImageQuery &query) const;
+
+private:
+    enum Column { NameCol, TimeCol, MinuteCol, CameraCol, MegapixelCol, SharpnessCol, ErrorCol, LatitudeCol, ColumnCount };
+
+    bool hasValue(int column, int row) const;
+    double key(int column, int row) const;
+    bool less(int column, int a, int b) const;
+    const QVector<int> &sorted(int column) const;
+    QPair<const int *, const int *> range(int column, double from, double to) const;
+    void buildSecondary() const;
+    bool matches(const ImageQuery &q, int row) const;
+    void changed();
+    void compact();
+
+    // Columns
+    QVector<QString> names;
+    QVector<quint8> alive;
+    QVector<qint64> times;          // ms since epoch, min() if unknown
+    QVector<qint16> minutes;        // minute of the day, -1 if unknown
+    QVector<quint16> cameras;       // code into cameraNames, 0 = none
+    QVector<float> megapixels;
+    QVector<float> sharpnesses;
+    QVector<float> errors;          // NaN if unknown
+    QVector<double> latitudes;      // NaN if unknown
+    QVector<double> longitudes;
+    QVector<quint8> registered;
+    QVector<QSize> sizes;
+    QStringList cameraNames{ QString() };
+    QHash<QString, int> rowByName;
+
+    // Indexes, rebuilt lazily after a change
+    mutable QVector<int> order[ColumnCount];
+    mutable bool orderValid[ColumnCount] = {};
+    mutable QVector<QVector<int>> rowsByCamera;
+    mutable QVector<int> rowsByRegistration[2];
+    mutable bool secondaryValid = false;
+
+    int generationCount = 0;
+};
+
+// Shows an ImageIndex result over the Image Manager's own item model: rows
+// are hidden and reordered, the items themselves are never rebuilt.
+//
+// Which source row holds each index row is kept up to date as tiles are
+// added and removed, so a new result maps straight through it: no item is
+// read, hashed or sorted per query. Source items are matched to index rows
+// by their text when they are inserted, and all at once only after the
+// index renumbers its rows.
+class ImageQueryProxy : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit ImageQueryProxy(const ImageIndex *index, QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *model) override;
+
+    // rows as returned by ImageIndex::run, shown in that order
+    void setResult(const QVector<int> &rows);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+
+private:
+    void rebuild();
+    void sourceInserted(int first, int last);
+    void sourceAboutToBeRemoved(int first, int last);
+    void sourceRemoved(int first, int last);
+    void sourceChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void sourceReset();
+
+    const ImageIndex *imageIndex;
+    int generation = -1;                 // of imageIndex when sourceRowByIndexRow was built
+    QVector<int> sourceRowByIndexRow;    // -1 = no tile
+    QVector<int> result;                 // source rows, in shown order
+    QVector<int> resultRowBySource;      // -1 = not in the result
+    enum { NoRemoval, RemovingRow, Resetting } removal = NoRemoval;   // how a source removal is forwarded
+};
+
+#endif // IMAGEINDEX_H
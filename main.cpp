@@ -1,13 +1,24 @@
 #include "mainwindow.h"
+#include "startuptrace.h"
+#include "shardworker.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    // Sharded feature extraction workers run headless
+    if (argc > 1 && qstrcmp(argv[1], "--shard-worker") == 0) {
+        QCoreApplication a(argc, argv);
+        return ShardWorker::run(a.arguments());
+    }
+
+    StartupTrace::start();
     QApplication a(argc, argv);
+    StartupTrace::mark("QApplication ready");
 
     MainWindow w;
     w.resize(800, 600);
     w.show();
+    StartupTrace::mark("window shown");
 
     return a.exec();
 }
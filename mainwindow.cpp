@@ -30,13 +30,96 @@
 #include <QDebug> // Add this for debugging image loading issues
 #include <QPainter> // Add this include for QPainter
 #include <QBitmap> // Add this include for QBitmap
+#include <QElapsedTimer>
+#include "startuptrace.h"
+#include "colmapdatabase.h"
+#include "matchgraphdialog.h"
+#include "modelviewer.h"
+#include "reconstructionpipeline.h"
+#include "pipelinecheckpoint.h"
+#include "shardcoordinator.h"
+#include "resourcegovernor.h"
+#include "exifreader.h"
+#include "colmapmodel.h"
+#include <QListView>
+#include <QSignalBlocker>
+#include <QRegularExpression>
+#include <QCloseEvent>
+#include <QItemSelection>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QImage>
+#include <QMouseEvent>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QStatusBar>
+#include <QSet>
+#include <memory>
+
+namespace
+{
+    // What ingest needs per image; built off the GUI thread
+    struct IngestedImage
+    {
+        QString path;
+        QString stored;            // what the tile points at: the project copy, or path itself
+        QImage thumbnail;
+        ExifInfo exif;
+        float sharpness = -1.0f;
+    };
+
+    ImageRecord recordFor(const IngestedImage &in)
+    {
+        ImageRecord r;
+        r.name = QFileInfo(in.path).fileName();
+        r.captureTime = in.exif.captureTime;
+        r.latitude = in.exif.latitude;
+        r.longitude = in.exif.longitude;
+        r.width = in.exif.width;
+        r.height = in.exif.height;
+        r.sharpness = in.sharpness;
+        return r;
+    }
 
+    // One image of an ingest, run on the thread pool by QtConcurrent::mapped
+    struct IngestImage
+    {
+        typedef IngestedImage result_type;
+
+        QSize thumbSize;
+        QString copyTo;            // folder to copy the image into first, empty for none
+
+        IngestedImage operator()(const QString &path) const
+        {
+            IngestedImage in;
+            in.path = path;
+            in.stored = path;
+            in.exif = ExifReader::read(path);
+
+            // Let the decoder scale down (JPEG does it in the DCT) instead of decoding full size
+            QImageReader reader(path);
+            if (reader.size().isValid())
+                reader.setScaledSize(reader.size().scaled(thumbSize, Qt::KeepAspectRatio));
+            in.thumbnail = reader.read();
+            in.sharpness = ImageIndex::sharpness(in.thumbnail);
+
+            if (!in.thumbnail.isNull() && !copyTo.isEmpty()) {
+                in.stored = QDir(copyTo).filePath(QFileInfo(path).fileName());
+                QFile::copy(path, in.stored);
+            }
+            return in;
+        }
+    };
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     setWindowTitle("Voxel Forge");
 
+    // Apply the app-wide style before any widget exists, so nothing has to be re-polished
+    setTheme(0);
+
     // central widget layout: left sidebar + right stacked content
     QWidget *central = new QWidget;
     QHBoxLayout *mainLayout = new QHBoxLayout(central);
@@ -89,12 +172,13 @@ MainWindow::MainWindow(QWidget *parent)
         );
     mainLayout->addWidget(sidebar);
 
-    // Stacked content (right)
+    // Stacked content (right). Only the home page is built up front, the rest
+    // are built the first time they are visited (see changePage)
     stackedContent = new QStackedWidget;
-    stackedContent->addWidget(createHomePage());
-    stackedContent->addWidget(createProjectManagerPage());
-    stackedContent->addWidget(createImageManagerPage());
-    stackedContent->addWidget(createSettingsPage());
+    for (int i = 0; i < PageCount; ++i)
+        stackedContent->addWidget(new QWidget);
+    ensurePage(HomePage);
+    stackedContent->setCurrentIndex(HomePage);
     mainLayout->addWidget(stackedContent, 1);
 
     setCentralWidget(central);
@@ -104,8 +188,75 @@ MainWindow::MainWindow(QWidget *parent)
     // connect
     connect(sidebar, &QListWidget::currentRowChanged, this, &MainWindow::changePage);
 
-    // default style/theme
-    setTheme(0);
+    // Map last session's snapshot now; its images go into the grid when the Image Manager is built
+    if (session.open(currentProjectFolder)) {
+        StartupTrace::mark(QString("session snapshot mapped (%1 images)").arg(session.count()));
+        showSessionStatus();
+    }
+
+    StartupTrace::mark("MainWindow constructed");
+
+    // Pick up a run that was cut short by a crash or power loss
+    QTimer::singleShot(0, this, &MainWindow::offerResume);
+    // Lets the governor's cgroup probe finish long before the first run
+    QTimer::singleShot(0, this, [this]() { resourceGovernor(); });
+}
+
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    saveSession();
+    QMainWindow::closeEvent(event);
+}
+
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (!firstPaintSeen) {
+        firstPaintSeen = true;
+        StartupTrace::firstPaint();
+    }
+}
+
+// Project Manager cards are plain widgets; a click on one starts its stage
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::MouseButtonRelease) {
+        QVariant stage = watched->property("pipelineStage");
+        if (stage.isValid() && static_cast<QMouseEvent *>(event)->button() == Qt::LeftButton) {
+            startReconstruction(stage.toInt());
+            return true;
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::ensurePage(int index)
+{
+    if (index < 0 || index >= PageCount || pageBuilt[index]) return;
+    pageBuilt[index] = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QWidget *page = nullptr;
+    QString name;
+    switch (index) {
+    case HomePage:           page = createHomePage();           name = "Home"; break;
+    case ProjectManagerPage: page = createProjectManagerPage(); name = "Project Manager"; break;
+    case ImageManagerPage:   page = createImageManagerPage();   name = "Image Manager"; break;
+    case SettingsPage:       page = createSettingsPage();       name = "Settings"; break;
+    }
+
+    // Swap the placeholder out for the real page, keeping the index stable
+    QWidget *placeholder = stackedContent->widget(index);
+    const bool wasCurrent = stackedContent->currentWidget() == placeholder;
+    stackedContent->insertWidget(index, page);
+    stackedContent->removeWidget(placeholder);
+    placeholder->deleteLater();
+    if (wasCurrent)
+        stackedContent->setCurrentWidget(page);
+
+    StartupTrace::pageBuilt(name, timer.nsecsElapsed());
 }
 
 
@@ -124,6 +275,15 @@ void MainWindow::createMenuBar()
     QMenu *tools = mb->addMenu("Tools");
     QAction *colmapAct = tools->addAction("Launch COLMAP GUI");
     connect(colmapAct, &QAction::triggered, this, &MainWindow::launchColmap);
+    QAction *matchGraphAct = tools->addAction("Analyze COLMAP Database...");
+    connect(matchGraphAct, &QAction::triggered, this, &MainWindow::analyzeColmapDatabase);
+    QAction *viewerAct = tools->addAction("Model Viewer...");
+    connect(viewerAct, &QAction::triggered, this, &MainWindow::openModelViewer);
+    QAction *shardAct = tools->addAction("Sharded Feature Extraction...");
+    connect(shardAct, &QAction::triggered, this, &MainWindow::runShardedExtraction);
+    tools->addSeparator();
+    QAction *cancelAct = tools->addAction("Cancel Reconstruction");
+    connect(cancelAct, &QAction::triggered, this, &MainWindow::cancelReconstruction);
 
     QMenu *help = mb->addMenu("Help");
     QAction *aboutAct = help->addAction("About");
@@ -235,32 +395,19 @@ QWidget* MainWindow::createProjectManagerPage()
         imageContainer->setFixedSize(250, 250); // Image size ke barabar container size
 
         QLabel *imageLabel = new QLabel(imageContainer); // QLabel ko container ke andar rakha
+        imageLabel->setObjectName("cardImage");
         imageLabel->setGeometry(0, 0, 250, 250); // Label ka size container ke barabar
         imageLabel->setAlignment(Qt::AlignCenter);
 
-        QPixmap originalPixmap(imagePath);
-        if (originalPixmap.isNull()) {
+        // Card art is pre-baked (250px, rounded corners, alpha) in resources.qrc,
+        // so there is no decode-scale-mask work here
+        QPixmap cardPixmap(imagePath);
+        if (cardPixmap.isNull()) {
             qDebug() << "Failed to load image:" << imagePath;
             imageLabel->setText("No Image");
             imageLabel->setStyleSheet("color: #aaaaaa; font-size: 14px;");
         } else {
-            // Pixmap ko round karne ke liye mask apply karna
-            QPixmap scaledPixmap = originalPixmap.scaled(250, 250, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-            QPixmap roundedPixmap(scaledPixmap.size());
-            roundedPixmap.fill(Qt::transparent); // Transparent background
-
-            QPainter painter(&roundedPixmap);
-            painter.setRenderHint(QPainter::Antialiasing);
-            painter.setRenderHint(QPainter::SmoothPixmapTransform);
-            painter.setBrush(QBrush(scaledPixmap));
-            painter.setPen(Qt::NoPen);
-
-            // Corner radius jitna aap chahte hain
-            int radius = 15; // Image ke corners ka radius
-            painter.drawRoundedRect(roundedPixmap.rect(), radius, radius);
-
-            imageLabel->setPixmap(roundedPixmap);
+            imageLabel->setPixmap(cardPixmap);
             imageLabel->setStyleSheet("background: transparent; border: none;");
         }
 
@@ -322,10 +469,23 @@ QWidget* MainWindow::createProjectManagerPage()
         return card;
     };
 
-    cardsLayout->addWidget(makeProjectCard("Generate Sparse Cloud", ":/icons/icons/sparse.jpg"));
-    cardsLayout->addWidget(makeProjectCard("Generate Dense Cloud", ":/icons/icons/dense.jpg"));
-    cardsLayout->addWidget(makeProjectCard("View Constructed 3D Model", ":/icons/icons/model.jpg"));
-    cardsLayout->addWidget(makeProjectCard("VR Connect", ":/icons/icons/vr.jpg"));
+    QWidget *sparseCard = makeProjectCard("Generate Sparse Cloud", ":/icons/icons/cards/sparse.png");
+    sparseCard->setProperty("pipelineStage", int(ReconstructionPipeline::Mapping));
+    sparseCard->installEventFilter(this);
+    cardsLayout->addWidget(sparseCard);
+
+    QWidget *denseCard = makeProjectCard("Generate Dense Cloud", ":/icons/icons/cards/dense.png");
+    denseCard->setProperty("pipelineStage", int(ReconstructionPipeline::Fusion));
+    denseCard->installEventFilter(this);
+    cardsLayout->addWidget(denseCard);
+
+    cardImages[CardPreviews::Sparse] = sparseCard->findChild<QLabel *>("cardImage");
+    cardImages[CardPreviews::Dense] = denseCard->findChild<QLabel *>("cardImage");
+    // After the page is on screen; a cached preview is a quick PNG load, a fresh one renders in the background
+    QTimer::singleShot(0, this, &MainWindow::refreshCardPreviews);
+
+    cardsLayout->addWidget(makeProjectCard("View Constructed 3D Model", ":/icons/icons/cards/model.png"));
+    cardsLayout->addWidget(makeProjectCard("VR Connect", ":/icons/icons/cards/vr.png"));
 
     mainPageLayout->addLayout(cardsLayout);
     mainPageLayout->addStretch();
@@ -419,6 +579,35 @@ QWidget* MainWindow::createImageManagerPage()
     header->addWidget(saveImagesButton);
     outer->addLayout(header);
 
+    cameraGroupsLabel = new QLabel;
+    cameraGroupsLabel->setWordWrap(true);
+    cameraGroupsLabel->setStyleSheet("color: #cfcfcf; font-size: 12px;");
+    cameraGroupsLabel->setVisible(false);
+    outer->addWidget(cameraGroupsLabel);
+
+    // Search row: filters and sorts the grid by file name, camera, time, GPS,
+    // sharpness and registration (ImageQuery::syntaxHelp)
+    QHBoxLayout *searchRow = new QHBoxLayout;
+    searchEdit = new QLineEdit;
+    searchEdit->setPlaceholderText("unregistered camera:B after:14:00 sort:blur");
+    searchEdit->setToolTip(ImageQuery::syntaxHelp());
+    searchEdit->setClearButtonEnabled(true);
+    searchEdit->setFixedHeight(32);
+    searchEdit->setStyleSheet(
+        "QLineEdit { background: rgba(0,0,0,0.15); color: #eaeaea; border: 1px solid rgba(255,255,255,0.08); "
+        "border-radius: 8px; padding: 4px 10px; font-size: 13px; }"
+        "QLineEdit:focus { border-color: #7b61ff; }"
+        );
+    searchStatus = new QLabel;
+    searchStatus->setStyleSheet("color: #cfcfcf; font-size: 12px;");
+    searchRow->addWidget(searchEdit, 1);
+    searchRow->addWidget(searchStatus);
+    outer->addLayout(searchRow);
+
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(150);
+
     // Image list as icon grid
     imageList = new QListWidget;
     imageList->setViewMode(QListView::IconMode);
@@ -439,10 +628,46 @@ QWidget* MainWindow::createImageManagerPage()
 
     outer->addWidget(imageList, 1);
 
+    // Query results: the same items through a proxy, so nothing is rebuilt per keystroke
+    queryProxy = new ImageQueryProxy(&imageIndex, this);
+    queryProxy->setSourceModel(imageList->model());
+    queryView = new QListView;
+    queryView->setModel(queryProxy);
+    queryView->setViewMode(QListView::IconMode);
+    queryView->setIconSize(imageList->iconSize());
+    queryView->setResizeMode(QListView::Adjust);
+    queryView->setMovement(QListView::Static);
+    queryView->setSpacing(12);
+    queryView->setUniformItemSizes(true);
+    queryView->setLayoutMode(QListView::Batched);
+    queryView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    queryView->setStyleSheet(QString(imageList->styleSheet()).replace("QListWidget", "QListView"));
+    queryView->hide();
+    outer->addWidget(queryView, 1);
+
     // connections
     connect(addImageButton, &QPushButton::clicked, this, &MainWindow::addImages);
     connect(saveImagesButton, &QPushButton::clicked, this, &MainWindow::saveSelectedImages);
     connect(deleteImagesButton, &QPushButton::clicked, this, &MainWindow::deleteSelectedImages);
+    connect(searchEdit, &QLineEdit::textChanged, searchTimer, qOverload<>(&QTimer::start));
+    connect(searchTimer, &QTimer::timeout, this, &MainWindow::runImageQuery);
+
+    // Tiles added or removed under an active query: run it again once they settle
+    auto requery = [this]() {
+        if (!queryView->isHidden()) searchTimer->start();
+    };
+    connect(imageList->model(), &QAbstractItemModel::rowsInserted, this, requery);
+    connect(imageList->model(), &QAbstractItemModel::rowsRemoved, this, requery);
+
+    // Selection lives in imageList, so save and delete work the same on a result
+    connect(queryView->selectionModel(), &QItemSelectionModel::selectionChanged, this,
+            [this](const QItemSelection &selected, const QItemSelection &deselected) {
+        imageList->selectionModel()->select(queryProxy->mapSelectionToSource(deselected), QItemSelectionModel::Deselect);
+        imageList->selectionModel()->select(queryProxy->mapSelectionToSource(selected), QItemSelectionModel::Select);
+    });
+
+    if (session.isValid())
+        QTimer::singleShot(0, this, &MainWindow::restoreSession);
 
     return page;
 }
@@ -482,8 +707,24 @@ void MainWindow::openProjectFolder()
 {
     QString dir = QFileDialog::getExistingDirectory(this, "Select Project Folder", currentProjectFolder);
     if (!dir.isEmpty()) {
+        saveSession();
         currentProjectFolder = dir;
+
+        // Tiles carry offsets into the old project's thumbnail pack; none may survive the switch
+        currentImageFolder.clear();
+        if (imageList) {
+            cancelIngest();
+            imageList->clear();
+            imageIndex.clear();
+        }
+        if (session.open(currentProjectFolder)) {
+            showSessionStatus();
+            if (imageList) restoreSession();
+        } else if (imageList) {
+            changeFolder(currentProjectFolder);
+        }
         QMessageBox::information(this, "Project Folder", QString("Project folder set to:\n%1").arg(currentProjectFolder));
+        offerResume();
     }
 }
 
@@ -552,13 +793,255 @@ void MainWindow::launchColmap()
     QProcess::startDetached("colmap", QStringList() << "gui");
 }
 
+void MainWindow::analyzeColmapDatabase()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Select COLMAP Database",
+                                                QDir(currentProjectFolder).filePath("database.db"),
+                                                "COLMAP database (*.db)");
+    if (path.isEmpty()) return;
+
+    // The database can hold millions of matches, keep the scan off the GUI thread
+    statusBar()->showMessage("Reading " + QFileInfo(path).fileName() + "...");
+    auto *watcher = new QFutureWatcher<ColmapMatchGraph>(this);
+    connect(watcher, &QFutureWatcher<ColmapMatchGraph>::finished, this, [this, watcher, path]() {
+        ColmapMatchGraph graph = watcher->result();
+        watcher->deleteLater();
+        statusBar()->clearMessage();
+
+        if (!graph.ok()) {
+            QMessageBox::warning(this, "COLMAP Database", QString("Could not read %1:\n%2").arg(path, graph.error));
+            return;
+        }
+
+        MatchGraphDialog *dlg = new MatchGraphDialog(graph, this);
+        dlg->setAttribute(Qt::WA_DeleteOnClose);
+        connect(dlg, &MatchGraphDialog::selectImagesRequested, this, &MainWindow::selectImagesByName);
+        dlg->show();
+    });
+    watcher->setFuture(QtConcurrent::run([path]() { return ColmapDatabase::analyze(path); }));
+}
+
+// Final sparse model if there is one, else the newest mapper snapshot of a run in progress
+QString MainWindow::sparseModelFolder() const
+{
+    const QString sparseFolder = QDir(currentProjectFolder).filePath("sparse/0");
+    if (!QFileInfo::exists(QDir(sparseFolder).filePath("points3D.bin"))) {
+        PipelineCheckpoint cp(currentProjectFolder);
+        if (cp.load() && !cp.sparseSnapshot.isEmpty())
+            return cp.sparseSnapshot;
+    }
+    return sparseFolder;
+}
+
+void MainWindow::openModelViewer()
+{
+    // Dense model if there is one; cameras and tracks always come from the sparse model
+    const QDir project(currentProjectFolder);
+    const QString sparseFolder = sparseModelFolder();
+    QString model = project.filePath("dense/fused.ply");
+    if (!QFileInfo::exists(model))
+        model = QDir(sparseFolder).filePath("points3D.bin");
+    if (!QFileInfo::exists(model)) {
+        QMessageBox::information(this, "Model Viewer", "This project has no reconstructed model yet.");
+        return;
+    }
+
+    ModelViewerDialog *dlg = new ModelViewerDialog(model, sparseFolder, this);
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    // The viewer stays in front and says itself which images were not in the list
+    connect(dlg, &ModelViewerDialog::selectImagesRequested, this, [this, dlg](const QStringList &names, bool reveal) {
+        dlg->showListedImages(selectImages(names, reveal), names.size());
+    });
+    dlg->show();
+}
+
+void MainWindow::startReconstruction(int lastStage)
+{
+    if ((pipeline && pipeline->isRunning()) || (shardCoordinator && shardCoordinator->isRunning())) {
+        QMessageBox::information(this, "Reconstruction", "A reconstruction is already running.");
+        return;
+    }
+
+    if (!pipeline || pipeline->projectFolder() != currentProjectFolder) {
+        delete pipeline;
+        pipeline = new ReconstructionPipeline(currentProjectFolder, this);
+        pipeline->setGovernor(resourceGovernor());
+        connect(pipeline, &ReconstructionPipeline::stageStarted, this, [this](int stage, const QString &detail) {
+            QString msg = ReconstructionPipeline::stageName(stage) + "...";
+            if (!detail.isEmpty()) msg += " (" + detail + ")";
+            statusBar()->showMessage(msg);
+        });
+        connect(pipeline, &ReconstructionPipeline::logMessage, this, [this](const QString &line) {
+            // "Registering image #12 (9)": 9 is the registered count including this one
+            static const QRegularExpression registering("Registering image #\\d+ \\((\\d+)\\)");
+            const QRegularExpressionMatch m = registering.match(line);
+            if (m.hasMatch()) registeredImages = m.captured(1).toInt();
+        });
+        connect(pipeline, &ReconstructionPipeline::stageFinished, this, [this](int stage) {
+            if (stage == ReconstructionPipeline::Mapping || stage == ReconstructionPipeline::Fusion)
+                refreshCardPreviews();
+            if (stage == ReconstructionPipeline::Mapping)
+                refreshRegistration();
+        });
+        connect(pipeline, &ReconstructionPipeline::finished, this, [this](bool ok, const QString &message) {
+            previewTimer->stop();
+            refreshCardPreviews();
+            refreshRegistration();
+            statusBar()->showMessage(message, 10000);
+            if (!ok)
+                QMessageBox::warning(this, "Reconstruction", message + "\n\nRun it again to resume from where it stopped.");
+        });
+    }
+
+    if (!previewTimer) {
+        previewTimer = new QTimer(this);
+        previewTimer->setInterval(5000);
+        connect(previewTimer, &QTimer::timeout, this, &MainWindow::refreshCardPreviews);
+    }
+    registeredImages = 0;
+    previewTimer->start();
+
+    pipeline->start(lastStage);
+}
+
+void MainWindow::refreshCardPreviews()
+{
+    if (!cardImages[CardPreviews::Sparse]) return;   // Project Manager not built yet
+
+    if (!cardPreviews) {
+        cardPreviews = new CardPreviews(this);
+        connect(cardPreviews, &CardPreviews::previewReady, this, &MainWindow::showCardPreview);
+    }
+
+    const QDir project(currentProjectFolder);
+    const QString sparseModel = QDir(sparseModelFolder()).filePath("points3D.bin");
+    const QString models[CardPreviews::KindCount] = { sparseModel, project.filePath("dense/fused.ply") };
+    const char *staticArt[CardPreviews::KindCount] = { ":/icons/icons/cards/sparse.png", ":/icons/icons/cards/dense.png" };
+    for (int kind = 0; kind < CardPreviews::KindCount; ++kind) {
+        if (QFileInfo::exists(models[kind])) {
+            cardPreviews->request(kind, currentProjectFolder, models[kind]);
+        } else if (!cardPreviewImages[kind].isNull()) {
+            // Project without this model (yet): back to the static art
+            cardPreviewImages[kind] = QImage();
+            cardImages[kind]->setPixmap(QPixmap(staticArt[kind]));
+        }
+    }
+
+    // Registration count changes between snapshots, redraw the overlay
+    if (!cardPreviewImages[CardPreviews::Sparse].isNull())
+        showCardPreview(CardPreviews::Sparse, cardPreviewImages[CardPreviews::Sparse]);
+}
+
+void MainWindow::showCardPreview(int kind, const QImage &image)
+{
+    cardPreviewImages[kind] = image;
+    QLabel *label = cardImages[kind];
+    if (!label) return;
+
+    QPixmap pm = QPixmap::fromImage(image);
+    const bool mapping = pipeline && pipeline->isRunning()
+                         && pipeline->currentStage() == ReconstructionPipeline::Mapping;
+    if (kind == CardPreviews::Sparse && mapping && registeredImages > 0) {
+        QPainter painter(&pm);
+        painter.setRenderHint(QPainter::Antialiasing);
+        const QRect band(0, pm.height() - 34, pm.width(), 34);
+        painter.fillRect(band, QColor(0, 0, 0, 150));
+        painter.setPen(Qt::white);
+        painter.drawText(band, Qt::AlignCenter, QString("Registered %1 images...").arg(registeredImages));
+    }
+    label->setPixmap(pm);
+}
+
+ResourceGovernor *MainWindow::resourceGovernor()
+{
+    if (!governor) {
+        governor = new ResourceGovernor(this);
+        connect(governor, &ResourceGovernor::message, this, [this](const QString &text) {
+            statusBar()->showMessage(text, 5000);
+        });
+    }
+    return governor;
+}
+
+void MainWindow::cancelReconstruction()
+{
+    if (pipeline) pipeline->cancel();
+    if (shardCoordinator) shardCoordinator->cancel();
+}
+
+void MainWindow::runShardedExtraction()
+{
+    if ((pipeline && pipeline->isRunning()) || (shardCoordinator && shardCoordinator->isRunning())) {
+        QMessageBox::information(this, "Sharded Extraction", "A reconstruction is already running.");
+        return;
+    }
+
+    bool ok = false;
+    const int nodes = ShardCoordinator::numaNodeCount();
+    const int shards = QInputDialog::getInt(this, "Sharded Feature Extraction",
+                                            QString("Number of shards (this machine has %1 NUMA node(s)):").arg(nodes),
+                                            qMax(2, nodes), 1, 256, 1, &ok);
+    if (!ok) return;
+
+    if (QFile::exists(QDir(currentProjectFolder).filePath("database.db"))
+        && QMessageBox::question(this, "Sharded Feature Extraction",
+                                 "The project already has a database.db. It will be kept as database.db.bak "
+                                 "and replaced by the merged shards. Continue?") != QMessageBox::Yes) {
+        return;
+    }
+
+    if (!shardCoordinator || shardCoordinator->projectFolder() != currentProjectFolder) {
+        delete shardCoordinator;
+        shardCoordinator = new ShardCoordinator(currentProjectFolder, this);
+        shardCoordinator->setGovernor(resourceGovernor());
+        connect(shardCoordinator, &ShardCoordinator::progress, this, [this](const QString &message) {
+            statusBar()->showMessage(message);
+        });
+        connect(shardCoordinator, &ShardCoordinator::finished, this, [this](bool ok, const QString &report) {
+            statusBar()->clearMessage();
+            if (ok)
+                QMessageBox::information(this, "Sharded Feature Extraction", report);
+            else
+                QMessageBox::warning(this, "Sharded Feature Extraction", report);
+        });
+    }
+
+    QString error;
+    if (!shardCoordinator->start(shards, &error))
+        QMessageBox::warning(this, "Sharded Feature Extraction", error);
+}
+
+void MainWindow::offerResume()
+{
+    PipelineCheckpoint cp(currentProjectFolder);
+    if (!cp.load() || !cp.running) return;
+    if (pipeline && pipeline->isRunning()) return;
+
+    const QString target = ReconstructionPipeline::stageName(cp.targetStage);
+    if (QMessageBox::question(this, "Resume Reconstruction",
+                              QString("A reconstruction in\n%1\nwas interrupted (last checkpoint %2).\n\n"
+                                      "Resume it up to \"%3\"?")
+                                  .arg(currentProjectFolder, cp.updated.toLocalTime().toString(), target)) == QMessageBox::Yes) {
+        startReconstruction(cp.targetStage);
+    } else {
+        // Don't ask again; the artifacts stay and a later run still resumes from them
+        cp.running = false;
+        cp.save();
+    }
+}
+
 void MainWindow::changePage(int index)
 {
+    ensurePage(index);
     stackedContent->setCurrentIndex(index);
 }
 
 void MainWindow::setTheme(int index)
 {
+    // Setting the app style sheet re-polishes every widget, so skip no-op changes
+    if (index == currentTheme) return;
+    currentTheme = index;
+
     if (index == 0) {
         // Dark theme
         qApp->setStyleSheet(
@@ -586,27 +1069,11 @@ void MainWindow::addImages()
 
     QDir dir(savePath);
     if (!dir.exists()) dir.mkpath(".");
+    if (currentImageFolder.isEmpty())
+        currentImageFolder = savePath;   // the grid now shows the project's own images
 
-    for (const QString &f : files) {
-        QFileInfo fi(f);
-        QPixmap pm(f);
-        if (pm.isNull()) continue;
-
-        // ✅ Save into project folder
-        QString dest = dir.filePath(fi.fileName());
-        QFile::copy(f, dest);
-
-        // ✅ Create thumbnail
-        QPixmap scaled = pm.scaled(320, 240, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-        // ✅ Add to imageList
-        QListWidgetItem *item = new QListWidgetItem;
-        item->setIcon(QIcon(scaled));
-        item->setText(fi.fileName());
-        item->setToolTip(dest); // show saved path on hover
-        item->setData(Qt::UserRole, dest); // store full path
-        imageList->addItem(item);       // <-- missing line before
-    }
+    // ✅ Each image is copied into the project folder and shown from there
+    ingestImages(files, savePath, true, QSize(320, 240));
 }
 
 
@@ -663,29 +1130,322 @@ void MainWindow::changeFolder(const QString &path)
 {
     // Update the current image folder
     currentImageFolder = path;
+    ensurePage(ImageManagerPage);
 
     // Clear existing list
+    cancelIngest();
     imageList->clear();
+    imageIndex.clear();
 
     // Populate images from the new folder
     QDir dir(path);
     QStringList filters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tiff"};
-    QFileInfoList files = dir.entryInfoList(filters, QDir::Files);
-    for (const QFileInfo &fi : files) {
-        QPixmap pm(fi.absoluteFilePath());
-        if (pm.isNull()) continue;
+    QStringList files;
+    for (const QFileInfo &fi : dir.entryInfoList(filters, QDir::Files))
+        files << fi.absoluteFilePath();
+
+    ingestImages(files, path, false, imageList->iconSize());
+}
+
+// Thumbnails, EXIF and sharpness are read on the thread pool and tiles are
+// added in order as results come in, so a large folder never holds up the
+// window. folder is the project whose camera groups get the images; with
+// copyIn each image is copied there first and its tile shows the copy.
+void MainWindow::ingestImages(const QStringList &paths, const QString &folder, bool copyIn, const QSize &thumbSize)
+{
+    if (paths.isEmpty()) return;
+
+    auto *watcher = new QFutureWatcher<IngestedImage>(this);
+    ingests << watcher;
+    auto next = std::make_shared<int>(0);
+    auto addReady = [this, watcher, next, folder]() {
+        const QFuture<IngestedImage> future = watcher->future();
+        CameraGroups &groups = cameraGroupsFor(folder);
+        for (; future.isResultReadyAt(*next); ++*next) {
+            const IngestedImage in = future.resultAt(*next);
+            if (in.thumbnail.isNull()) continue;
+            const QString name = QFileInfo(in.path).fileName();
+            groups.set(name, in.exif);
+            imageIndex.insert(recordFor(in));
+
+            QListWidgetItem *item = new QListWidgetItem;
+            item->setIcon(QIcon(QPixmap::fromImage(in.thumbnail)));
+            item->setText(name);
+            item->setToolTip(in.stored);
+            item->setData(Qt::UserRole, in.stored);
+            imageList->addItem(item);
+        }
+    };
+    connect(watcher, &QFutureWatcher<IngestedImage>::resultReadyAt, this, addReady);
+    connect(watcher, &QFutureWatcher<IngestedImage>::finished, this, [this, watcher, folder, addReady]() {
+        addReady();
+        ingests.removeAll(watcher);
+        watcher->deleteLater();
+        cameraGroupsFor(folder).save();
+        refreshCameraGroups();
+        refreshRegistration();
+    });
+    watcher->setFuture(QtConcurrent::mapped(paths, IngestImage{ thumbSize, copyIn ? folder : QString() }));
+}
 
-        QPixmap scaled = pm.scaled(imageList->iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+// Drops ingests whose tiles would land in a grid that was cleared since
+void MainWindow::cancelIngest()
+{
+    for (QFutureWatcherBase *watcher : ingests) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->cancel();
+        watcher->deleteLater();
+    }
+    ingests.clear();
+}
+
+// Rebuilds the Image Manager from the mapped snapshot in one pass: no
+// source image is opened and thumbnails decode when first painted
+void MainWindow::restoreSession()
+{
+    if (!session.isValid() || !imageList) return;
+
+    QElapsedTimer timer;
+    timer.start();
 
+    imageList->setUpdatesEnabled(false);
+    cancelIngest();
+    imageList->clear();
+    imageIndex.clear();
+    QItemSelection selection;
+    const int n = session.count();
+    for (int i = 0; i < n; ++i) {
+        const SessionSnapshot::Entry e = session.entry(i);
         QListWidgetItem *item = new QListWidgetItem;
-        item->setIcon(QIcon(scaled));
-        item->setText(fi.fileName());
-        item->setToolTip(fi.absoluteFilePath());
-        item->setData(Qt::UserRole, fi.absoluteFilePath());
+        item->setIcon(session.thumbnail(i));
+        item->setText(e.name);
+        item->setToolTip(e.path);
+        item->setData(Qt::UserRole, e.path);
+        item->setData(CameraGroupRole, e.cameraGroup);
+        if (e.thumbLength > 0) {
+            item->setData(ThumbOffsetRole, e.thumbOffset);
+            item->setData(ThumbLengthRole, e.thumbLength);
+        }
         imageList->addItem(item);
+        imageIndex.insert({ e.name, e.cameraGroup, e.captureTime, e.latitude, e.longitude,
+                            e.width, e.height, e.sharpness });
+        if (e.selected) {
+            const QModelIndex index = imageList->model()->index(i, 0);
+            selection.select(index, index);
+        }
     }
+    imageList->selectionModel()->select(selection, QItemSelectionModel::Select);
+    imageList->setUpdatesEnabled(true);
+
+    currentImageFolder = session.folder();
+    if (currentImageFolder.isEmpty())
+        currentImageFolder = currentProjectFolder;   // snapshots from before addImages set it
+    cameraGroupsFor(currentImageFolder);
+    refreshCameraGroups();
+    refreshRegistration();
+
+    // The icons keep the thumbnail pack mapped; the snapshot itself is no longer needed
+    session.close();
+    StartupTrace::mark(QString("session restored: %1 images in %2 ms").arg(n).arg(timer.elapsed()));
 }
 
+void MainWindow::saveSession()
+{
+    if (!imageList) return;   // Image Manager never opened: the snapshot on disk is still current
+
+    QVector<SessionSnapshot::Entry> entries;
+    entries.reserve(imageList->count());
+    for (int i = 0; i < imageList->count(); ++i) {
+        QListWidgetItem *item = imageList->item(i);
+        SessionSnapshot::Entry e;
+        e.name = item->text();
+        e.path = item->data(Qt::UserRole).toString();
+        e.cameraGroup = item->data(CameraGroupRole).toString();
+        const ImageRecord r = imageIndex.record(e.name);
+        e.width = r.width;
+        e.height = r.height;
+        e.captureTime = r.captureTime;
+        e.latitude = r.latitude;
+        e.longitude = r.longitude;
+        e.sharpness = r.sharpness;
+        e.selected = item->isSelected();
+        if (item->data(ThumbLengthRole).isValid()) {
+            e.thumbOffset = item->data(ThumbOffsetRole).toLongLong();
+            e.thumbLength = item->data(ThumbLengthRole).toInt();
+        } else {
+            e.thumbnail = item->icon().pixmap(imageList->iconSize()).toImage();
+        }
+        entries << e;
+    }
+
+    PipelineCheckpoint cp(currentProjectFolder);
+    cp.load();
+    const QString folder = currentImageFolder.isEmpty() ? currentProjectFolder : currentImageFolder;
+    if (!SessionSnapshot::write(currentProjectFolder, folder, entries, cp))
+        qDebug() << "Failed to write session snapshot for" << currentProjectFolder;
+
+    // Remember where each thumbnail went so the next save only appends new
+    // ones; a thumbnail compaction could not keep is re-rendered next time.
+    // Done even after a failure: the pack may already have been compacted.
+    for (int i = 0; i < entries.size(); ++i) {
+        QListWidgetItem *item = imageList->item(i);
+        if (entries[i].thumbOffset < 0) {
+            item->setData(ThumbOffsetRole, QVariant());
+            item->setData(ThumbLengthRole, QVariant());
+            continue;
+        }
+        item->setData(ThumbOffsetRole, entries[i].thumbOffset);
+        item->setData(ThumbLengthRole, entries[i].thumbLength);
+    }
+}
+
+void MainWindow::showSessionStatus()
+{
+    const SessionSnapshot::PipelineStatus s = session.pipelineStatus();
+    QStringList parts;
+    parts << QString("%1 image(s)").arg(session.count());
+    if (s.imagesWithFeatures > 0) parts << QString("features for %1").arg(s.imagesWithFeatures);
+    if (s.matchingDone) parts << "matched";
+    if (s.sparseDone) parts << "sparse model ready";
+    if (s.depthMapsTotal > 0) parts << QString("%1/%2 depth maps").arg(s.depthMapsDone).arg(s.depthMapsTotal);
+    if (s.fusionDone) parts << "dense model ready";
+    statusBar()->showMessage("Last session: " + parts.join(", "), 15000);
+}
+
+CameraGroups &MainWindow::cameraGroupsFor(const QString &folder)
+{
+    if (cameraGroups.folder() != folder) {
+        cameraGroups = CameraGroups(folder);
+        cameraGroups.load();
+    }
+    return cameraGroups;
+}
+
+// Per-group counts above the grid, and the group on every tile's tooltip
+void MainWindow::refreshCameraGroups()
+{
+    const QVector<CameraGroup> groups = cameraGroups.groups();
+    QStringList lines;
+    for (const CameraGroup &g : groups) {
+        QString line = QString("<b>%1</b> %2 &mdash; %3 image(s)").arg(g.id, g.label.toHtmlEscaped()).arg(g.images.size());
+        if (!g.sharesCamera()) line += " <i>(no EXIF, one camera per image)</i>";
+        else if (g.cameraParams().isEmpty()) line += " <i>(no focal prior)</i>";
+        lines << line;
+    }
+    cameraGroupsLabel->setText(lines.isEmpty() ? QString() : "Camera groups: " + lines.join(" &nbsp;&middot;&nbsp; "));
+    cameraGroupsLabel->setVisible(!lines.isEmpty());
+
+    const QHash<QString, QString> ids = cameraGroups.groupIds();
+    for (int i = 0; i < imageList->count(); ++i) {
+        QListWidgetItem *item = imageList->item(i);
+        const QString id = ids.value(item->text());
+        item->setData(CameraGroupRole, id);
+        imageIndex.setCameraGroup(item->text(), id);
+        const QString path = item->data(Qt::UserRole).toString();
+        item->setToolTip(id.isEmpty() ? path : QString("%1\nCamera %2").arg(path, id));
+    }
+}
+
+
+// Select the Image Manager tiles whose file names are in the list
+void MainWindow::selectImagesByName(const QStringList &fileNames)
+{
+    if (selectImages(fileNames, true) == 0)
+        QMessageBox::information(this, "Image Manager", "None of those images are in the current list.");
+}
+
+// Selects the tiles whose file names are in the list and returns how many
+// there were. With reveal the Image Manager is brought forward; without it
+// the selection happens behind whatever window has focus.
+int MainWindow::selectImages(const QStringList &fileNames, bool reveal)
+{
+    ensurePage(ImageManagerPage);
+    if (reveal)
+        sidebar->setCurrentRow(ImageManagerPage);
+    if (!searchEdit->text().isEmpty()) {
+        searchEdit->clear();    // the wanted tiles may be filtered out
+        searchTimer->stop();
+        runImageQuery();
+    }
+
+    const QSet<QString> wanted(fileNames.begin(), fileNames.end());
+    QListWidgetItem *first = nullptr;
+    int found = 0;
+    imageList->clearSelection();
+    for (int i = 0; i < imageList->count(); ++i) {
+        QListWidgetItem *item = imageList->item(i);
+        if (!wanted.contains(item->text())) continue;
+        item->setSelected(true);
+        ++found;
+        if (!first) first = item;
+    }
+    if (first)
+        imageList->scrollToItem(first);
+    return found;
+}
+
+// Runs the search box against imageIndex and shows the result through queryProxy
+void MainWindow::runImageQuery()
+{
+    QString error;
+    const ImageQuery query = ImageQuery::parse(searchEdit->text(), &error);
+    if (!error.isEmpty()) {
+        searchStatus->setText(error);   // keep the last result until the query parses
+        return;
+    }
+    if (query.isEmpty()) {
+        queryView->hide();
+        imageList->show();
+        searchStatus->clear();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<int> rows = imageIndex.run(query);
+    queryProxy->setResult(rows);
+    const double ms = timer.nsecsElapsed() / 1e6;
+
+    // Save and delete act on imageList's selection, so a tile the result
+    // hides must leave it: Delete would otherwise remove files not shown
+    QItemSelection hidden;
+    for (const QModelIndex &index : imageList->selectionModel()->selectedIndexes())
+        if (!queryProxy->mapFromSource(index).isValid()) hidden.select(index, index);
+    imageList->selectionModel()->select(hidden, QItemSelectionModel::Deselect);
+
+    // Mirror the tiles still selected; blocked so it is not written back
+    {
+        const QSignalBlocker blocker(queryView->selectionModel());
+        queryView->selectionModel()->select(queryProxy->mapSelectionFromSource(imageList->selectionModel()->selection()),
+                                            QItemSelectionModel::ClearAndSelect);
+    }
+    queryView->viewport()->update();
+    imageList->hide();
+    queryView->show();
+    searchStatus->setText(QString("%1 of %2 images, %3 ms").arg(rows.size()).arg(imageIndex.size()).arg(ms, 0, 'f', 1));
+}
+
+// Which images the sparse model registered, and their reprojection error,
+// for the registered/unregistered/err terms of the search box
+void MainWindow::refreshRegistration()
+{
+    // A read still running for an older model or folder must not land after this one
+    const int request = ++registrationRequests;
+    const QString folder = sparseModelFolder();
+    if (!QFileInfo::exists(QDir(folder).filePath("points3D.bin"))) {
+        imageIndex.setRegistration({});
+        return;
+    }
+
+    auto *watcher = new QFutureWatcher<QHash<QString, double>>(this);
+    connect(watcher, &QFutureWatcher<QHash<QString, double>>::finished, this, [this, watcher, request]() {
+        watcher->deleteLater();
+        if (request != registrationRequests) return;
+        imageIndex.setRegistration(watcher->result());
+        if (queryView && !queryView->isHidden()) runImageQuery();
+    });
+    watcher->setFuture(QtConcurrent::run([folder]() { return ColmapModel::registeredImageErrors(folder); }));
+}
 
 void MainWindow::deleteSelectedImages()
 {
@@ -705,7 +1465,13 @@ void MainWindow::deleteSelectedImages()
         QString path = it->data(Qt::UserRole).toString();
         if (!path.isEmpty() && QFile::exists(path))
             QFile::remove(path);
+        cameraGroups.remove(it->text());
+        imageIndex.remove(it->text());
 
         delete imageList->takeItem(imageList->row(it));
     }
+
+    if (!cameraGroups.folder().isEmpty())
+        cameraGroups.save();
+    refreshCameraGroups();
 }
@@ -5,13 +5,28 @@
 #include <QVector>
 #include <QString>
 #include <QDir>
+#include "cameragroups.h"
+#include "cardpreviews.h"
+#include "sessionsnapshot.h"
+#include "imageindex.h"
+#include <QImage>
 
 
 class QListWidget;
+class QListView;
+class QLineEdit;
 class QStackedWidget;
 class QPushButton;
 class QComboBox;
 class QListWidgetItem;
+class QLabel;
+class QPaintEvent;
+class QCloseEvent;
+class ReconstructionPipeline;
+class ShardCoordinator;
+class ResourceGovernor;
+class QTimer;
+class QFutureWatcherBase;
 
 static const QString defaultProjectPath = QDir::homePath() + "/Voxel-Forge/";
 
@@ -23,6 +38,11 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override = default;
 
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void closeEvent(QCloseEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     // Menu actions
     void openProjectFolder();
@@ -30,6 +50,18 @@ private slots:
 
     // Buttons / UI
     void launchColmap();
+    void analyzeColmapDatabase();
+    void openModelViewer();
+
+    // Reconstruction
+    void startReconstruction(int lastStage);
+    void cancelReconstruction();
+    void offerResume();
+    void runShardedExtraction();
+
+    // Project Manager card previews
+    void refreshCardPreviews();
+    void showCardPreview(int kind, const QImage &image);
     void changePage(int index);
     void setTheme(int index);
 
@@ -39,9 +71,34 @@ private slots:
     void deleteSelectedImages();
     void createNewFolder();
     void changeFolder(const QString &folderName);
+    void selectImagesByName(const QStringList &fileNames);
+    void runImageQuery();
+    void refreshRegistration();
 
 private:
+    // Sidebar rows / stacked pages, in order
+    enum Page { HomePage, ProjectManagerPage, ImageManagerPage, SettingsPage, PageCount };
+
     void createMenuBar();
+    void ensurePage(int index);   // builds a page on first visit
+
+    // imageList item role holding the tile's camera group id
+    static const int CameraGroupRole = Qt::UserRole + 1;
+    // where the tile's thumbnail sits in the session's thumbnails.pack
+    static const int ThumbOffsetRole = Qt::UserRole + 2;
+    static const int ThumbLengthRole = Qt::UserRole + 3;
+    CameraGroups &cameraGroupsFor(const QString &folder);
+    void refreshCameraGroups();
+    void ingestImages(const QStringList &paths, const QString &folder, bool copyIn, const QSize &thumbSize);
+    void cancelIngest();
+    ResourceGovernor *resourceGovernor();
+    int selectImages(const QStringList &fileNames, bool reveal);
+    QString sparseModelFolder() const;
+
+    // Session snapshot (see SessionSnapshot)
+    void restoreSession();
+    void saveSession();
+    void showSessionStatus();
     QWidget* createHomePage();
     QWidget* createProjectManagerPage();
     QWidget* createImageManagerPage();
@@ -56,9 +113,43 @@ private:
     QPushButton *addImageButton = nullptr;
     QPushButton *saveImagesButton = nullptr;
     QPushButton *deleteImagesButton = nullptr;   // new button
+    QLabel *cameraGroupsLabel = nullptr;
+
+    // EXIF camera grouping for the folder shown in the Image Manager
+    CameraGroups cameraGroups;
+
+    // Metadata search over the Image Manager tiles
+    ImageIndex imageIndex;
+    ImageQueryProxy *queryProxy = nullptr;
+    QListView *queryView = nullptr;      // shown in place of imageList while a query is active
+    QLineEdit *searchEdit = nullptr;
+    QLabel *searchStatus = nullptr;
+    QTimer *searchTimer = nullptr;       // debounces typing
+    int registrationRequests = 0;        // only the latest refreshRegistration() may apply its result
+    QList<QFutureWatcherBase *> ingests; // running ingestImages(), dropped when the grid is cleared
 
     // theme
     QComboBox *themeCombo = nullptr;
+    int currentTheme = -1;
+
+    // pages are built lazily; a placeholder sits in the stack until then
+    bool pageBuilt[PageCount] = {};
+    bool firstPaintSeen = false;
+
+    // reconstruction runner for currentProjectFolder, created on first use
+    ReconstructionPipeline *pipeline = nullptr;
+    ShardCoordinator *shardCoordinator = nullptr;
+    ResourceGovernor *governor = nullptr;    // limits for every COLMAP child
+
+    // live model previews on the Sparse/Dense cards
+    CardPreviews *cardPreviews = nullptr;
+    QLabel *cardImages[CardPreviews::KindCount] = {};
+    QImage cardPreviewImages[CardPreviews::KindCount];
+    QTimer *previewTimer = nullptr;     // throttles preview updates during a run
+    int registeredImages = 0;           // from the mapper log
+
+    // mapped at startup, replayed into imageList when the Image Manager is built
+    SessionSnapshot session;
 
     // state
     QString currentProjectFolder = defaultProjectPath;
@@ -0,0 +1,139 @@
+#include "matchgraphdialog.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QFileInfo>
+#include <QBrush>
+#include <QColor>
+
+namespace
+{
+    enum Column { NameCol, CameraCol, KeypointsCol, MatchedCol, VerifiedCol, InlierCol, ComponentCol, ColumnCount };
+
+    // Numeric cells sort by value instead of by text
+    class NumberItem : public QTableWidgetItem
+    {
+    public:
+        NumberItem(double value, const QString &text) : QTableWidgetItem(text)
+        {
+            setData(Qt::UserRole, value);
+            setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        bool operator<(const QTableWidgetItem &other) const override
+        {
+            return data(Qt::UserRole).toDouble() < other.data(Qt::UserRole).toDouble();
+        }
+    };
+
+    QTableWidgetItem *numberItem(double value, const QString &text)
+    {
+        return new NumberItem(value, text);
+    }
+}
+
+MatchGraphDialog::MatchGraphDialog(const ColmapMatchGraph &g, QWidget *parent)
+    : QDialog(parent), graph(g)
+{
+    setWindowTitle("Match Graph");
+    resize(820, 560);
+
+    QVBoxLayout *v = new QVBoxLayout(this);
+
+    summaryLabel = new QLabel;
+    summaryLabel->setStyleSheet("color: #eaeaea; font-size: 13px;");
+    summaryLabel->setWordWrap(true);
+    v->addWidget(summaryLabel);
+
+    QHBoxLayout *row = new QHBoxLayout;
+    QLabel *minLabel = new QLabel("Flag images with fewer verified pairs than:");
+    minLabel->setStyleSheet("color: #cfcfcf;");
+    minPairsSpin = new QSpinBox;
+    minPairsSpin->setRange(0, 1000);
+    minPairsSpin->setValue(3);
+    row->addWidget(minLabel);
+    row->addWidget(minPairsSpin);
+    row->addStretch();
+    QPushButton *selectButton = new QPushButton("Select Weak Images in Image Manager");
+    selectButton->setCursor(Qt::PointingHandCursor);
+    row->addWidget(selectButton);
+    v->addLayout(row);
+
+    table = new QTableWidget(graph.images.size(), ColumnCount);
+    table->setHorizontalHeaderLabels({ "Image", "Camera", "Keypoints", "Matched pairs",
+                                       "Verified pairs", "Inlier ratio", "Component" });
+    table->horizontalHeader()->setSectionResizeMode(NameCol, QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+
+    for (int r = 0; r < graph.images.size(); ++r) {
+        const ColmapImageStats &s = graph.images[r];
+        QTableWidgetItem *nameItem = new QTableWidgetItem(s.name);
+        nameItem->setData(Qt::UserRole, r);   // index into graph.images, survives sorting
+        table->setItem(r, NameCol, nameItem);
+        table->setItem(r, CameraCol, numberItem(s.cameraId, QString::number(s.cameraId)));
+        table->setItem(r, KeypointsCol, numberItem(s.keypoints, QString::number(s.keypoints)));
+        table->setItem(r, MatchedCol, numberItem(s.matchedPairs, QString::number(s.matchedPairs)));
+        table->setItem(r, VerifiedCol, numberItem(s.verifiedPairs, QString::number(s.verifiedPairs)));
+        table->setItem(r, InlierCol, numberItem(s.inlierRatio(), QString::number(s.inlierRatio() * 100.0, 'f', 1) + " %"));
+        table->setItem(r, ComponentCol, numberItem(s.component, QString::number(s.component + 1)));
+    }
+    table->setSortingEnabled(true);
+    v->addWidget(table, 1);
+
+    QPushButton *closeButton = new QPushButton("Close");
+    QHBoxLayout *bottom = new QHBoxLayout;
+    bottom->addStretch();
+    bottom->addWidget(closeButton);
+    v->addLayout(bottom);
+
+    connect(minPairsSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &MatchGraphDialog::refreshWeakImages);
+    connect(selectButton, &QPushButton::clicked, this, &MatchGraphDialog::selectWeakImages);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+
+    refreshWeakImages();
+}
+
+bool MatchGraphDialog::isWeak(const ColmapImageStats &s) const
+{
+    // Anything outside the largest component will not register with the main model
+    return s.component != 0 || s.verifiedPairs < minPairsSpin->value();
+}
+
+void MatchGraphDialog::refreshWeakImages()
+{
+    int weak = 0;
+    for (int r = 0; r < table->rowCount(); ++r) {
+        const int index = table->item(r, NameCol)->data(Qt::UserRole).toInt();
+        const bool flagged = isWeak(graph.images[index]);
+        weak += flagged ? 1 : 0;
+        for (int c = 0; c < ColumnCount; ++c)
+            table->item(r, c)->setForeground(flagged ? QBrush(QColor("#ff7b7b")) : QBrush());
+    }
+
+    const int largest = graph.componentSizes.isEmpty() ? 0 : graph.componentSizes.first();
+    summaryLabel->setText(QString("<b>%1</b> images, <b>%2</b> matched pairs, <b>%3</b> verified pairs.<br>"
+                                  "<b>%4</b> connected component(s); the largest holds <b>%5</b> images.<br>"
+                                  "<b>%6</b> image(s) look weakly connected (shown in red).")
+                              .arg(graph.images.size())
+                              .arg(graph.matchedPairs)
+                              .arg(graph.verifiedPairs)
+                              .arg(graph.componentSizes.size())
+                              .arg(largest)
+                              .arg(weak));
+}
+
+void MatchGraphDialog::selectWeakImages()
+{
+    QStringList names;
+    for (const ColmapImageStats &s : graph.images) {
+        if (isWeak(s))
+            names << QFileInfo(s.name).fileName();
+    }
+    emit selectImagesRequested(names);
+}
@@ -0,0 +1,38 @@
+#ifndef MATCHGRAPHDIALOG_H
+#define MATCHGRAPHDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+#include "colmapdatabase.h"
+
+class QLabel;
+class QSpinBox;
+class QTableWidget;
+
+// Shows per-image matching stats and the match graph components from a
+// COLMAP database, and flags images that are weakly connected.
+class MatchGraphDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MatchGraphDialog(const ColmapMatchGraph &graph, QWidget *parent = nullptr);
+
+signals:
+    // File names (without folders) of the images the user wants to act on
+    void selectImagesRequested(const QStringList &fileNames);
+
+private slots:
+    void refreshWeakImages();
+    void selectWeakImages();
+
+private:
+    bool isWeak(const ColmapImageStats &s) const;
+
+    ColmapMatchGraph graph;
+    QLabel *summaryLabel = nullptr;
+    QSpinBox *minPairsSpin = nullptr;
+    QTableWidget *table = nullptr;
+};
+
+#endif // MATCHGRAPHDIALOG_H
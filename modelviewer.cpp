@@ -0,0 +1,456 @@
+#include "modelviewer.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QListWidget>
+#include <QTimer>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLocale>
+#include <QDir>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Points drawn per frame while dragging and once the view settles
+    const int kInteractivePoints = 300000;
+    const int kSettledPoints = 4000000;
+    const int kPickPixels = 6;
+}
+
+ModelView::ModelView(QWidget *parent)
+    : QWidget(parent)
+{
+    setMinimumSize(480, 360);
+    setMouseTracking(false);
+    setCursor(Qt::CrossCursor);
+
+    settleTimer = new QTimer(this);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(150);
+    connect(settleTimer, &QTimer::timeout, this, [this]() {
+        interacting = false;
+        frameValid = false;
+        update();
+    });
+}
+
+void ModelView::setModel(const PointCloud &c, const PointIndex *i, const QVector<ColmapView> &v)
+{
+    cloud = c;
+    index = i;
+    views = v;
+    markers.clear();
+    highlighted.clear();
+
+    // Same framing as the card previews: median centre, 90th percentile radius
+    if (!cloud.isEmpty()) {
+        auto median = [&](int axis) {
+            QVector<float> values;
+            values.reserve(cloud.size());
+            for (const QVector3D &p : cloud.positions) values << p[axis];
+            std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+            return values[values.size() / 2];
+        };
+        target = QVector3D(median(0), median(1), median(2));
+        center = target;
+
+        QVector<float> dist;
+        dist.reserve(cloud.size());
+        for (const QVector3D &p : cloud.positions) dist << (p - center).length();
+        const int k = int(dist.size() * 0.9);
+        std::nth_element(dist.begin(), dist.begin() + k, dist.end());
+        radius = qMax(dist[k], 1e-6f);
+        extent = qMax(*std::max_element(dist.begin(), dist.end()), radius);
+        for (const ColmapView &view : views)
+            extent = qMax(extent, (view.center - center).length());
+        scale = 0.45f * qMin(width(), height()) / radius;
+    }
+    invalidate(false);
+}
+
+void ModelView::setShowCameras(bool show)
+{
+    showCameras = show;
+    update();
+}
+
+void ModelView::setHighlightedViews(const QSet<quint32> &imageIds)
+{
+    highlighted = imageIds;
+    update();
+}
+
+void ModelView::setMarkers(const QVector<QVector3D> &points)
+{
+    markers = points;
+    update();
+}
+
+float ModelView::pickRadius() const
+{
+    return kPickPixels / scale;
+}
+
+// COLMAP's world has y pointing down, as in CardPreviews::render
+QMatrix4x4 ModelView::viewMatrix() const
+{
+    QMatrix4x4 view;
+    view.rotate(pitch, 1, 0, 0);
+    view.rotate(yaw, 0, 1, 0);
+    view.scale(1.0f, -1.0f, 1.0f);
+    view.translate(-target);
+    return view;
+}
+
+QPointF ModelView::project(const QMatrix4x4 &view, const QVector3D &p) const
+{
+    const QVector3D v = view.map(p);
+    return QPointF(width() / 2.0 + v.x() * scale, height() / 2.0 - v.y() * scale);
+}
+
+void ModelView::invalidate(bool interactive)
+{
+    frameValid = false;
+    if (interactive) {
+        interacting = true;
+        settleTimer->start();
+    }
+    update();
+}
+
+void ModelView::renderPoints()
+{
+    const int w = width(), h = height();
+    frame = QImage(size(), QImage::Format_RGB32);
+    frame.fill(QColor("#030317"));
+    frameValid = true;
+    if (cloud.isEmpty()) return;
+
+    const QMatrix4x4 view = viewMatrix();
+    const int budget = interacting ? kInteractivePoints : kSettledPoints;
+    const int stride = qMax(1, (cloud.size() + budget - 1) / budget);
+    QVector<float> depth(w * h, std::numeric_limits<float>::max());
+    const QVector3D *positions = cloud.positions.constData();
+    const QRgb *colors = cloud.colors.constData();
+
+    for (int i = 0; i < cloud.size(); i += stride) {
+        const QVector3D v = view.map(positions[i]);
+        const int x = int(w / 2 + v.x() * scale);
+        const int y = int(h / 2 - v.y() * scale);
+        if (x < 0 || x >= w || y < 0 || y >= h) continue;
+        const float z = -v.z();   // smaller is nearer
+        float &d = depth[y * w + x];
+        if (z >= d) continue;
+        d = z;
+        const float shade = qBound(0.45f, 0.75f - 0.3f * z / radius, 1.0f);
+        const QRgb c = colors[i];
+        reinterpret_cast<QRgb *>(frame.scanLine(y))[x] = qRgb(int(qRed(c) * shade), int(qGreen(c) * shade), int(qBlue(c) * shade));
+    }
+}
+
+void ModelView::paintEvent(QPaintEvent *)
+{
+    if (!frameValid || frame.size() != size())
+        renderPoints();
+
+    QPainter p(this);
+    p.drawImage(0, 0, frame);
+    p.setRenderHint(QPainter::Antialiasing);
+    const QMatrix4x4 view = viewMatrix();
+
+    if (showCameras && !views.isEmpty()) {
+        // Frustums a few percent of the model size; observing cameras on top
+        const float depth = radius * 0.06f;
+        const QColor dim(120, 120, 160, 110), lit("#ffb347");
+        for (int pass = 0; pass < 2; ++pass) {
+            p.setPen(QPen(pass == 0 ? dim : lit, pass == 0 ? 1.0 : 2.0));
+            for (const ColmapView &cam : views) {
+                if (highlighted.contains(cam.imageId) != (pass == 1)) continue;
+                const QPointF apex = project(view, cam.center);
+                const QVector<QVector3D> corners = cam.frustumCorners(depth);
+                QPointF c[4];
+                for (int k = 0; k < 4; ++k) c[k] = project(view, corners[k]);
+                for (int k = 0; k < 4; ++k) {
+                    p.drawLine(apex, c[k]);
+                    p.drawLine(c[k], c[(k + 1) % 4]);
+                }
+            }
+        }
+    }
+
+    if (!markers.isEmpty()) {
+        p.setPen(QPen(QColor("#00e5ff"), 2.0));
+        p.setBrush(Qt::NoBrush);
+        QPointF previous;
+        for (int k = 0; k < markers.size(); ++k) {
+            const QPointF at = project(view, markers[k]);
+            p.drawEllipse(at, 5, 5);
+            if (k > 0) {
+                p.drawLine(previous, at);
+                const float d = (markers[k] - markers[k - 1]).length();
+                p.drawText((previous + at) / 2 + QPointF(6, -6), QString::number(d, 'g', 5));
+            }
+            previous = at;
+        }
+    }
+}
+
+void ModelView::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    invalidate(true);
+}
+
+void ModelView::mousePressEvent(QMouseEvent *event)
+{
+    pressPos = lastPos = event->pos();
+    dragButton = event->button();
+}
+
+void ModelView::mouseMoveEvent(QMouseEvent *event)
+{
+    const QPoint delta = event->pos() - lastPos;
+    lastPos = event->pos();
+    if (dragButton == Qt::LeftButton) {
+        yaw += delta.x() * 0.4f;
+        pitch = qBound(-90.0f, pitch - delta.y() * 0.4f, 90.0f);
+    } else if (dragButton == Qt::RightButton || dragButton == Qt::MiddleButton) {
+        // Pan in the view plane
+        const QMatrix4x4 inverse = viewMatrix().inverted();
+        target -= inverse.mapVector(QVector3D(delta.x() / scale, -delta.y() / scale, 0.0f));
+    } else {
+        return;
+    }
+    invalidate(true);
+}
+
+void ModelView::mouseReleaseEvent(QMouseEvent *event)
+{
+    const bool click = dragButton == Qt::LeftButton && (event->pos() - pressPos).manhattanLength() < 4;
+    dragButton = Qt::NoButton;
+    if (!click || !index) return;
+
+    // Orthographic: the ray runs straight into the screen from the eye,
+    // which sits on the current view axis in front of everything. Panning
+    // moves target away from center, so the distance is measured from there.
+    QElapsedTimer timer;
+    timer.start();
+    const QMatrix4x4 inverse = viewMatrix().inverted();
+    const float vx = (event->pos().x() - width() / 2.0f) / scale;
+    const float vy = -(event->pos().y() - height() / 2.0f) / scale;
+    const float eyeDistance = (target - center).length() + extent * 1.01f;
+    const QVector3D origin = inverse.map(QVector3D(vx, vy, eyeDistance));
+    const QVector3D direction = inverse.mapVector(QVector3D(0, 0, -1)).normalized();
+    const int hit = index->pick(origin, direction, pickRadius());
+    const qint64 ns = timer.nsecsElapsed();
+
+    if (hit >= 0)
+        emit pointPicked(hit, ns);
+    else
+        emit pickMissed();
+}
+
+void ModelView::wheelEvent(QWheelEvent *event)
+{
+    const float steps = event->angleDelta().y() / 120.0f;
+    scale *= std::pow(1.15f, steps);
+    invalidate(true);
+}
+
+ModelViewerDialog::ModelViewerDialog(const QString &modelPath, const QString &sparseFolder, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Model Viewer - " + QFileInfo(modelPath).fileName());
+    resize(1100, 700);
+
+    QHBoxLayout *h = new QHBoxLayout(this);
+    view = new ModelView;
+    h->addWidget(view, 1);
+
+    QVBoxLayout *side = new QVBoxLayout;
+    summaryLabel = new QLabel("Loading " + QDir::toNativeSeparators(modelPath) + "...");
+    summaryLabel->setStyleSheet("color: #eaeaea; font-size: 13px;");
+    summaryLabel->setWordWrap(true);
+    side->addWidget(summaryLabel);
+
+    camerasCheck = new QCheckBox("Show cameras");
+    camerasCheck->setChecked(true);
+    side->addWidget(camerasCheck);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    measureButton = new QPushButton("Measure");
+    measureButton->setCheckable(true);
+    measureButton->setCursor(Qt::PointingHandCursor);
+    measureButton->setToolTip("Click two points to measure the distance between them (model units)");
+    QPushButton *clearButton = new QPushButton("Clear");
+    clearButton->setCursor(Qt::PointingHandCursor);
+    buttons->addWidget(measureButton);
+    buttons->addWidget(clearButton);
+    side->addLayout(buttons);
+
+    pointLabel = new QLabel("Click a point to see the images that observe it.");
+    pointLabel->setStyleSheet("color: #cfcfcf;");
+    pointLabel->setWordWrap(true);
+    side->addWidget(pointLabel);
+
+    imagesList = new QListWidget;
+    side->addWidget(imagesList, 1);
+
+    QWidget *sidePanel = new QWidget;
+    sidePanel->setLayout(side);
+    sidePanel->setFixedWidth(280);
+    h->addWidget(sidePanel);
+
+    connect(camerasCheck, &QCheckBox::toggled, view, &ModelView::setShowCameras);
+    connect(measureButton, &QPushButton::toggled, this, &ModelViewerDialog::clearSelection);
+    connect(clearButton, &QPushButton::clicked, this, &ModelViewerDialog::clearSelection);
+    connect(view, &ModelView::pointPicked, this, &ModelViewerDialog::pointPicked);
+    connect(view, &ModelView::pickMissed, this, [this]() {
+        if (!measureButton->isChecked()) clearSelection();
+    });
+    connect(imagesList, &QListWidget::itemDoubleClicked, this, [this](QListWidgetItem *item) {
+        emit selectImagesRequested({ item->text() }, true);
+    });
+
+    // Loading and indexing a full-resolution model takes a while; keep it off the GUI thread
+    auto *watcher = new QFutureWatcher<Model>(this);
+    connect(watcher, &QFutureWatcher<Model>::finished, this, [this, watcher]() {
+        modelLoaded(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&ModelViewerDialog::load, modelPath, sparseFolder));
+}
+
+ModelViewerDialog::Model ModelViewerDialog::load(const QString &modelPath, const QString &sparseFolder)
+{
+    Model m;
+    m.cloud = PointCloudLoader::load(modelPath, 0, &m.error);
+    if (m.cloud.isEmpty()) {
+        if (m.error.isEmpty()) m.error = "No points in " + modelPath;
+        return m;
+    }
+    m.index.build(m.cloud.positions);
+
+    // A dense cloud has no tracks: borrow them from the nearest sparse point
+    if (!m.cloud.hasTracks()) {
+        m.sparse = PointCloudLoader::loadColmapPoints(QDir(sparseFolder).filePath("points3D.bin"));
+        m.sparseIndex.build(m.sparse.positions);
+    }
+
+    QString viewError;
+    m.views = ColmapModel::loadViews(sparseFolder, &viewError);
+    return m;
+}
+
+void ModelViewerDialog::modelLoaded(const Model &m)
+{
+    if (!m.error.isEmpty()) {
+        summaryLabel->setText("Could not load the model:\n" + m.error);
+        return;
+    }
+
+    model = m;
+    viewById.clear();
+    for (int i = 0; i < model.views.size(); ++i)
+        viewById.insert(model.views[i].imageId, i);
+    view->setModel(model.cloud, &model.index, model.views);
+
+    QString summary = QString("%1 points, indexed in %2 ms\n%3 cameras")
+                          .arg(QLocale().toString(model.cloud.size()))
+                          .arg(model.index.buildMs())
+                          .arg(model.views.size());
+    if (!model.cloud.hasTracks() && model.sparse.isEmpty())
+        summary += "\nNo sparse model, image lookup unavailable";
+    summaryLabel->setText(summary);
+}
+
+QVector<quint32> ModelViewerDialog::observingImages(int index) const
+{
+    if (model.cloud.hasTracks())
+        return model.cloud.observingImages(index);
+
+    // Tolerance: a few clicks' worth around the picked dense point
+    const int nearest = model.sparseIndex.nearest(model.cloud.positions[index], view->pickRadius() * 4.0f);
+    return nearest >= 0 ? model.sparse.observingImages(nearest) : QVector<quint32>();
+}
+
+void ModelViewerDialog::pointPicked(int index, qint64 pickNs)
+{
+    const QVector3D p = model.cloud.positions[index];
+    const QString pickTime = QString("picked in %1 ms").arg(pickNs / 1e6, 0, 'f', 3);
+
+    if (measureButton->isChecked()) {
+        if (measurePoints.size() >= 2) measurePoints.clear();
+        measurePoints << p;
+        view->setMarkers(measurePoints);
+        if (measurePoints.size() == 2) {
+            const QVector3D d = measurePoints[1] - measurePoints[0];
+            pointLabel->setText(QString("Distance: %1\n(dx %2, dy %3, dz %4)\n%5")
+                                    .arg(d.length(), 0, 'g', 6)
+                                    .arg(d.x(), 0, 'g', 4).arg(d.y(), 0, 'g', 4).arg(d.z(), 0, 'g', 4)
+                                    .arg(pickTime));
+        } else {
+            pointLabel->setText("Click the second point. (" + pickTime + ")");
+        }
+        return;
+    }
+
+    view->setMarkers({ p });
+    const QVector<quint32> imageIds = observingImages(index);
+    QSet<quint32> ids;
+    QStringList names;
+    imagesList->clear();
+    for (quint32 id : imageIds) {
+        if (ids.contains(id)) continue;
+        ids.insert(id);
+        const int v = viewById.value(id, -1);
+        if (v < 0) continue;
+        const QString name = QFileInfo(model.views[v].name).fileName();
+        names << name;
+        imagesList->addItem(name);
+    }
+    view->setHighlightedViews(ids);
+
+    QString text = QString("Point (%1, %2, %3)\n").arg(p.x(), 0, 'g', 6).arg(p.y(), 0, 'g', 6).arg(p.z(), 0, 'g', 6);
+    if (index < model.cloud.ids.size())
+        text += QString("point3D_id %1\n").arg(model.cloud.ids[index]);
+    text += QString("Observed by %1 image(s), %2").arg(names.size()).arg(pickTime);
+    pointLabel->setText(text);
+    pointText = text;
+
+    if (!names.isEmpty())
+        emit selectImagesRequested(names, false);
+}
+
+void ModelViewerDialog::showListedImages(int listed, int requested)
+{
+    QString line;
+    if (listed == 0)
+        line = requested == 1 ? "Not in the Image Manager list." : "None of them are in the Image Manager list.";
+    else if (listed < requested)
+        line = QString("%1 of %2 selected in the Image Manager; the rest are not in its list.").arg(listed).arg(requested);
+    else
+        line = "Selected in the Image Manager.";
+    pointLabel->setText(pointText + "\n\n" + line);
+}
+
+void ModelViewerDialog::clearSelection()
+{
+    measurePoints.clear();
+    imagesList->clear();
+    view->setMarkers({});
+    view->setHighlightedViews({});
+    pointLabel->setText(measureButton->isChecked() ? "Click the first point."
+                                                   : "Click a point to see the images that observe it.");
+}
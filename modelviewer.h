@@ -0,0 +1,131 @@
+#ifndef MODELVIEWER_H
+#define MODELVIEWER_H
+
+#include <QDialog>
+#include <QWidget>
+#include <QImage>
+#include <QHash>
+#include <QSet>
+#include <QMatrix4x4>
+#include <QStringList>
+#include "pointcloud.h"
+#include "pointindex.h"
+#include "colmapmodel.h"
+
+class QLabel;
+class QCheckBox;
+class QPushButton;
+class QListWidget;
+class QTimer;
+
+// Orbiting orthographic CPU view of a point cloud with the model's camera
+// frustums on top. Drawing is level-of-detail (a strided subset while the
+// view is being dragged, more once it settles); picking goes through the
+// full-resolution PointIndex, so it is exact whatever is on screen.
+class ModelView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ModelView(QWidget *parent = nullptr);
+
+    void setModel(const PointCloud &cloud, const PointIndex *index, const QVector<ColmapView> &views);
+    void setShowCameras(bool show);
+    void setHighlightedViews(const QSet<quint32> &imageIds);
+    void setMarkers(const QVector<QVector3D> &points);   // selection or measurement, in order
+
+    // World-space radius a click covers at the current zoom
+    float pickRadius() const;
+
+signals:
+    void pointPicked(int index, qint64 pickNs);
+    void pickMissed();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    QMatrix4x4 viewMatrix() const;
+    QPointF project(const QMatrix4x4 &view, const QVector3D &p) const;
+    void renderPoints();
+    void invalidate(bool interactive);
+
+    PointCloud cloud;
+    const PointIndex *index = nullptr;
+    QVector<ColmapView> views;
+    QSet<quint32> highlighted;
+    QVector<QVector3D> markers;
+    bool showCameras = true;
+
+    QVector3D target;
+    float radius = 1.0f;        // 90th percentile distance from target
+    QVector3D center;           // target as first framed
+    float extent = 1.0f;        // farthest point or camera from center, bounds pick rays
+    float yaw = 35.0f;
+    float pitch = -20.0f;
+    float scale = 1.0f;         // pixels per world unit
+
+    QImage frame;
+    bool frameValid = false;
+    bool interacting = false;
+    QTimer *settleTimer = nullptr;
+    QPoint pressPos;
+    QPoint lastPos;
+    Qt::MouseButton dragButton = Qt::NoButton;
+};
+
+// Viewer for a project's sparse or dense model: click a point to see the
+// images that observe it (and select them in the Image Manager), or
+// measure between two points.
+class ModelViewerDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ModelViewerDialog(const QString &modelPath, const QString &sparseFolder, QWidget *parent = nullptr);
+
+    // How many of the images last requested are in the Image Manager list
+    void showListedImages(int listed, int requested);
+
+signals:
+    // File names (without folders) of the images observing the selected
+    // point. reveal brings the Image Manager forward; a pick only selects.
+    void selectImagesRequested(const QStringList &fileNames, bool reveal);
+
+private slots:
+    void pointPicked(int index, qint64 pickNs);
+    void clearSelection();
+
+private:
+    struct Model
+    {
+        PointCloud cloud;
+        PointIndex index;
+        PointCloud sparse;          // tracks, when the cloud itself is dense
+        PointIndex sparseIndex;
+        QVector<ColmapView> views;
+        QString error;
+    };
+    static Model load(const QString &modelPath, const QString &sparseFolder);
+    void modelLoaded(const Model &m);
+    QVector<quint32> observingImages(int index) const;
+
+    Model model;
+    QHash<quint32, int> viewById;
+    QVector<QVector3D> measurePoints;
+    QString pointText;          // pointLabel without the Image Manager line
+
+    ModelView *view = nullptr;
+    QLabel *summaryLabel = nullptr;
+    QLabel *pointLabel = nullptr;
+    QCheckBox *camerasCheck = nullptr;
+    QPushButton *measureButton = nullptr;
+    QListWidget *imagesList = nullptr;
+};
+
+#endif // MODELVIEWER_H
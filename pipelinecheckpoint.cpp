@@ -0,0 +1,93 @@
+#include "pipelinecheckpoint.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+namespace
+{
+    QJsonArray toArray(const QStringList &list)
+    {
+        return QJsonArray::fromStringList(list);
+    }
+
+    QStringList toStringList(const QJsonValue &value)
+    {
+        QStringList out;
+        for (const QJsonValue &v : value.toArray())
+            out << v.toString();
+        return out;
+    }
+}
+
+PipelineCheckpoint::PipelineCheckpoint(const QString &folder)
+    : projectFolder(folder)
+{
+}
+
+QString PipelineCheckpoint::manifestPath() const
+{
+    return QDir(projectFolder).filePath(".voxelforge/checkpoint.json");
+}
+
+bool PipelineCheckpoint::load()
+{
+    QFile f(manifestPath());
+    if (!f.open(QIODevice::ReadOnly)) return false;
+
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll()).object();
+    if (root.value("version").toInt() != kVersion) return false;
+
+    running = root.value("running").toBool();
+    targetStage = root.value("targetStage").toInt(-1);
+    updated = QDateTime::fromString(root.value("updated").toString(), Qt::ISODate);
+
+    const QJsonObject features = root.value("features").toObject();
+    featuresDone = features.value("done").toBool();
+    imagesWithFeatures = toStringList(features.value("images"));
+
+    const QJsonObject matching = root.value("matching").toObject();
+    matchingDone = matching.value("done").toBool();
+    matchedPairs = qint64(matching.value("pairs").toDouble());
+
+    const QJsonObject sparse = root.value("sparse").toObject();
+    sparseDone = sparse.value("done").toBool();
+    sparseSnapshot = sparse.value("snapshot").toString();
+
+    undistortionDone = root.value("undistortion").toObject().value("done").toBool();
+
+    const QJsonObject stereo = root.value("stereo").toObject();
+    depthMapsDone = toStringList(stereo.value("depthMaps"));
+    depthMapsTotal = stereo.value("total").toInt();
+
+    fusionDone = root.value("fusion").toObject().value("done").toBool();
+    return true;
+}
+
+bool PipelineCheckpoint::save()
+{
+    QDir().mkpath(QFileInfo(manifestPath()).absolutePath());
+    updated = QDateTime::currentDateTimeUtc();
+
+    QJsonObject root;
+    root["version"] = kVersion;
+    root["running"] = running;
+    root["targetStage"] = targetStage;
+    root["updated"] = updated.toString(Qt::ISODate);
+    root["features"] = QJsonObject{ { "done", featuresDone }, { "images", toArray(imagesWithFeatures) } };
+    root["matching"] = QJsonObject{ { "done", matchingDone }, { "pairs", double(matchedPairs) } };
+    root["sparse"] = QJsonObject{ { "done", sparseDone }, { "snapshot", sparseSnapshot } };
+    root["undistortion"] = QJsonObject{ { "done", undistortionDone } };
+    root["stereo"] = QJsonObject{ { "depthMaps", toArray(depthMapsDone) }, { "total", depthMapsTotal } };
+    root["fusion"] = QJsonObject{ { "done", fusionDone } };
+
+    // QSaveFile writes to a temp file, syncs it and renames it over the old manifest
+    QSaveFile f(manifestPath());
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    return f.commit();
+}
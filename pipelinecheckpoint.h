@@ -0,0 +1,43 @@
+#ifndef PIPELINECHECKPOINT_H
+#define PIPELINECHECKPOINT_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+
+// Durable record of how far a reconstruction got.
+//
+// Stored as <project>/.voxelforge/checkpoint.json and replaced atomically on
+// every save, so a crash leaves either the old or the new manifest, never a
+// torn one. The manifest is only a hint: ReconstructionPipeline re-checks
+// the artifacts on disk before trusting any of it.
+class PipelineCheckpoint
+{
+public:
+    static const int kVersion = 1;
+
+    explicit PipelineCheckpoint(const QString &projectFolder = QString());
+
+    QString manifestPath() const;
+    bool load();
+    bool save();
+
+    QString projectFolder;
+
+    bool running = false;          // true while a run is in flight; still true after a crash
+    int targetStage = -1;          // last stage the interrupted run was asked to reach
+    QDateTime updated;
+
+    QStringList imagesWithFeatures;
+    bool featuresDone = false;
+    qint64 matchedPairs = 0;       // progress only: which pairs are done is not recorded
+    bool matchingDone = false;
+    QString sparseSnapshot;        // latest mapper snapshot, empty if none
+    bool sparseDone = false;
+    bool undistortionDone = false;
+    QStringList depthMapsDone;
+    int depthMapsTotal = 0;
+    bool fusionDone = false;
+};
+
+#endif // PIPELINECHECKPOINT_H
@@ -0,0 +1,200 @@
+#include "pointcloud.h"
+#include "colmapmodel.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QStringList>
+#include <cstring>
+
+namespace
+{
+    template <typename T>
+    T readLE(const uchar *p)
+    {
+        T v;
+        std::memcpy(&v, p, sizeof(T));   // x86 and ARM hosts are little endian, like the files
+        return v;
+    }
+
+    int plyTypeSize(const QString &type)
+    {
+        if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+        if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+        if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32") return 4;
+        if (type == "double" || type == "float64") return 8;
+        return 0;
+    }
+
+    double plyValue(const uchar *p, const QString &type)
+    {
+        if (type == "float" || type == "float32") return readLE<float>(p);
+        if (type == "double" || type == "float64") return readLE<double>(p);
+        if (type == "uchar" || type == "uint8") return *p;
+        if (type == "char" || type == "int8") return qint8(*p);
+        if (type == "ushort" || type == "uint16") return readLE<quint16>(p);
+        if (type == "short" || type == "int16") return readLE<qint16>(p);
+        if (type == "uint" || type == "uint32") return readLE<quint32>(p);
+        if (type == "int" || type == "int32") return readLE<qint32>(p);
+        return 0.0;
+    }
+}
+
+PointCloud PointCloudLoader::load(const QString &path, int maxPoints, QString *error)
+{
+    if (path.endsWith(".ply", Qt::CaseInsensitive))
+        return loadPly(path, maxPoints, error);
+    return loadColmapPoints(path, maxPoints, error);
+}
+
+PointCloud PointCloudLoader::loadColmapPoints(const QString &path, int maxPoints, QString *error)
+{
+    PointCloud cloud;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return cloud;
+    }
+    const qint64 size = f.size();
+    const uchar *data = f.map(0, size);
+    if (!data || size < 8) {
+        if (error) *error = "Could not map " + path;
+        return cloud;
+    }
+
+    // Per point: id u64, xyz 3*f64, rgb 3*u8, error f64, track length u64,
+    // then track length * (image_id u32, point2D_idx u32)
+    // The header count is not trusted further than the file can hold
+    const qint64 fixed = 8 + 24 + 3 + 8 + 8;
+    const quint64 count = qMin(readLE<quint64>(data), quint64(size - 8) / quint64(fixed));
+    const quint64 stride = (maxPoints > 0 && count > quint64(maxPoints)) ? (count + maxPoints - 1) / maxPoints : 1;
+    cloud.positions.reserve(int(count / stride) + 1);
+    cloud.colors.reserve(int(count / stride) + 1);
+    cloud.ids.reserve(int(count / stride) + 1);
+    cloud.trackOffsets.reserve(int(count / stride) + 2);
+    cloud.trackOffsets << 0;
+
+    qint64 pos = 8;
+    for (quint64 i = 0; i < count; ++i) {
+        if (pos + fixed > size) break;
+        const uchar *p = data + pos;
+        const quint64 trackLength = readLE<quint64>(p + 43);
+        qint64 next = pos + fixed;
+        if (!ColmapModel::skipRecords(next, trackLength, 8, size)) break;
+        if (i % stride == 0) {
+            cloud.ids << readLE<quint64>(p);
+            cloud.positions << QVector3D(float(readLE<double>(p + 8)), float(readLE<double>(p + 16)), float(readLE<double>(p + 24)));
+            cloud.colors << qRgb(p[32], p[33], p[34]);
+            // Track elements are (image_id, point2D_idx); only the image matters here
+            for (quint64 t = 0; t < trackLength; ++t)
+                cloud.trackImages << readLE<quint32>(p + fixed + t * 8);
+            cloud.trackOffsets << quint32(cloud.trackImages.size());
+        }
+        pos = next;
+    }
+
+    f.unmap(const_cast<uchar *>(data));
+    return cloud;
+}
+
+PointCloud PointCloudLoader::loadPly(const QString &path, int maxPoints, QString *error)
+{
+    PointCloud cloud;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return cloud;
+    }
+
+    // Header: only the vertex element's scalar properties matter
+    QString format;
+    qint64 vertexCount = 0;
+    bool inVertex = false;
+    QStringList names, types;
+    while (!f.atEnd()) {
+        const QString line = QString::fromLatin1(f.readLine()).trimmed();
+        const QStringList tok = line.split(' ', Qt::SkipEmptyParts);
+        if (tok.isEmpty()) continue;
+        if (tok[0] == "format") {
+            format = tok.value(1);
+        } else if (tok[0] == "element") {
+            inVertex = tok.value(1) == "vertex";
+            if (inVertex) vertexCount = tok.value(2).toLongLong();
+        } else if (tok[0] == "property" && inVertex) {
+            if (tok.value(1) == "list") {
+                if (error) *error = "List properties on vertices are not supported";
+                return cloud;
+            }
+            // Every offset after an unknown type would be wrong
+            if (plyTypeSize(tok.value(1)) == 0) {
+                if (error) *error = "Unsupported PLY property type: " + tok.value(1);
+                return cloud;
+            }
+            types << tok.value(1);
+            names << tok.value(2);
+        } else if (tok[0] == "end_header") {
+            break;
+        }
+    }
+
+    const int ix = names.indexOf("x"), iy = names.indexOf("y"), iz = names.indexOf("z");
+    const int ir = names.indexOf("red"), ig = names.indexOf("green"), ib = names.indexOf("blue");
+    if (ix < 0 || iy < 0 || iz < 0 || vertexCount <= 0) {
+        if (error) *error = "No vertex positions in " + path;
+        return cloud;
+    }
+
+    QVector<int> offsets;
+    int rowSize = 0;
+    for (const QString &t : types) {
+        offsets << rowSize;
+        rowSize += plyTypeSize(t);
+    }
+    // Trust the header count only as far as the rest of the file can hold:
+    // a binary row is rowSize bytes, an ascii one at least a digit and a
+    // separator per property
+    const qint64 minRow = format == "ascii" ? 2 * qint64(names.size()) : qint64(rowSize);
+    vertexCount = qMin(vertexCount, (f.size() - f.pos()) / minRow);
+    if (vertexCount <= 0) {
+        if (error) *error = "No vertex data in " + path;
+        return cloud;
+    }
+    const qint64 stride = (maxPoints > 0 && vertexCount > maxPoints) ? (vertexCount + maxPoints - 1) / maxPoints : 1;
+    cloud.positions.reserve(int(vertexCount / stride) + 1);
+    cloud.colors.reserve(int(vertexCount / stride) + 1);
+
+    if (format == "binary_little_endian") {
+        const qint64 start = f.pos();
+        const qint64 length = qMin(f.size() - start, vertexCount * rowSize);
+        const uchar *data = f.map(start, length);
+        if (!data) {
+            if (error) *error = "Could not map " + path;
+            return cloud;
+        }
+        const qint64 rows = length / rowSize;
+        for (qint64 i = 0; i < rows; i += stride) {
+            const uchar *p = data + i * rowSize;
+            cloud.positions << QVector3D(float(plyValue(p + offsets[ix], types[ix])),
+                                         float(plyValue(p + offsets[iy], types[iy])),
+                                         float(plyValue(p + offsets[iz], types[iz])));
+            cloud.colors << (ir >= 0 && ig >= 0 && ib >= 0
+                                 ? qRgb(int(plyValue(p + offsets[ir], types[ir])),
+                                        int(plyValue(p + offsets[ig], types[ig])),
+                                        int(plyValue(p + offsets[ib], types[ib])))
+                                 : qRgb(200, 200, 200));
+        }
+        f.unmap(const_cast<uchar *>(data));
+    } else if (format == "ascii") {
+        QTextStream in(&f);
+        for (qint64 i = 0; i < vertexCount && !in.atEnd(); ++i) {
+            const QStringList v = in.readLine().split(' ', Qt::SkipEmptyParts);
+            if (i % stride != 0 || v.size() < names.size()) continue;
+            cloud.positions << QVector3D(v[ix].toFloat(), v[iy].toFloat(), v[iz].toFloat());
+            cloud.colors << (ir >= 0 && ig >= 0 && ib >= 0 ? qRgb(v[ir].toInt(), v[ig].toInt(), v[ib].toInt())
+                                                           : qRgb(200, 200, 200));
+        }
+    } else if (error) {
+        *error = "Unsupported PLY format: " + format;
+    }
+    return cloud;
+}
@@ -0,0 +1,48 @@
+#ifndef POINTCLOUD_H
+#define POINTCLOUD_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QColor>
+#include <QString>
+
+// Plain point cloud: positions and colours, same length
+struct PointCloud
+{
+    QVector<QVector3D> positions;
+    QVector<QRgb> colors;
+    QVector<quint64> ids;       // COLMAP point3D_id for sparse models, empty for PLY
+
+    // Inverted track index for sparse models: the COLMAP image_ids that
+    // observe point i are trackImages[trackOffsets[i] .. trackOffsets[i + 1]).
+    // Empty for PLY.
+    QVector<quint32> trackOffsets;
+    QVector<quint32> trackImages;
+
+    int size() const { return positions.size(); }
+    bool isEmpty() const { return positions.isEmpty(); }
+    bool hasTracks() const { return !trackOffsets.isEmpty(); }
+    QVector<quint32> observingImages(int index) const
+    {
+        if (!hasTracks()) return {};
+        return trackImages.mid(int(trackOffsets[index]), int(trackOffsets[index + 1] - trackOffsets[index]));
+    }
+};
+
+// Loaders for the two model files Voxel Forge produces. Both map the file
+// instead of reading it through a stream. maxPoints > 0 keeps an evenly
+// strided subset, which is what the previews use.
+class PointCloudLoader
+{
+public:
+    // COLMAP sparse model: points3D.bin, with the observing images of each point
+    static PointCloud loadColmapPoints(const QString &path, int maxPoints = 0, QString *error = nullptr);
+
+    // stereo_fusion output: fused.ply (binary little endian or ascii)
+    static PointCloud loadPly(const QString &path, int maxPoints = 0, QString *error = nullptr);
+
+    // Picks the loader by file name
+    static PointCloud load(const QString &path, int maxPoints = 0, QString *error = nullptr);
+};
+
+#endif // POINTCLOUD_H
@@ -0,0 +1,211 @@
+#include "pointindex.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    // Entry and exit distance of a ray through a box, false if it misses
+    bool rayBox(const QVector3D &origin, const QVector3D &inverse, const QVector3D &min, const QVector3D &max,
+                float tMax, float &tEnter)
+    {
+        float t0 = 0.0f, t1 = tMax;
+        for (int a = 0; a < 3; ++a) {
+            float tNear = (min[a] - origin[a]) * inverse[a];
+            float tFar = (max[a] - origin[a]) * inverse[a];
+            if (tNear > tFar) std::swap(tNear, tFar);
+            // NaN from 0 * inf (ray in the slab plane) must not reject the box
+            if (tNear > t0) t0 = tNear;
+            if (tFar < t1) t1 = tFar;
+            if (t0 > t1) return false;
+        }
+        tEnter = t0;
+        return true;
+    }
+
+    float boxDistanceSquared(const QVector3D &p, const QVector3D &min, const QVector3D &max)
+    {
+        float d = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+            const float v = p[a] < min[a] ? min[a] - p[a] : (p[a] > max[a] ? p[a] - max[a] : 0.0f);
+            d += v * v;
+        }
+        return d;
+    }
+}
+
+void PointIndex::clear()
+{
+    points.clear();
+    perm.clear();
+    boxes.clear();
+    buildTime = 0;
+}
+
+void PointIndex::build(const QVector<QVector3D> &positions)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    clear();
+    points = positions;
+    const int n = points.size();
+    if (n == 0) return;
+
+    perm.resize(n);
+    std::iota(perm.begin(), perm.end(), 0u);
+
+    // Halving until ranges fit a leaf gives a complete tree of this depth
+    int depth = 0;
+    while ((n >> depth) > kLeafSize) ++depth;
+    boxes.resize(2 << (depth + 1));
+
+    // A few levels of tasks are enough to cover every core
+    parallelDepth = 0;
+    while ((1 << parallelDepth) < QThread::idealThreadCount() * 2) ++parallelDepth;
+
+    buildNode(1, 0, n, 0);
+    buildTime = timer.elapsed();
+}
+
+void PointIndex::buildNode(int node, int lo, int hi, int depth)
+{
+    // points is shared with the cloud: const access only, or it would detach
+    const QVector3D *pts = points.constData();
+    Box &box = boxes[node];
+    if (isLeaf(lo, hi)) {
+        const float inf = std::numeric_limits<float>::max();
+        box.min = QVector3D(inf, inf, inf);
+        box.max = QVector3D(-inf, -inf, -inf);
+        for (int i = lo; i < hi; ++i) {
+            const QVector3D &p = pts[perm[i]];
+            for (int a = 0; a < 3; ++a) {
+                box.min[a] = std::min(box.min[a], p[a]);
+                box.max[a] = std::max(box.max[a], p[a]);
+            }
+        }
+        return;
+    }
+
+    // Split along the longest axis of the range. The root pass over all
+    // points is the only serial one; below it the halves run concurrently.
+    QVector3D min = pts[perm[lo]], max = min;
+    for (int i = lo + 1; i < hi; ++i) {
+        const QVector3D &p = pts[perm[i]];
+        for (int a = 0; a < 3; ++a) {
+            min[a] = std::min(min[a], p[a]);
+            max[a] = std::max(max[a], p[a]);
+        }
+    }
+    const QVector3D extent = max - min;
+    const int axis = extent.x() >= extent.y() && extent.x() >= extent.z() ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+    const int mid = lo + (hi - lo) / 2;
+    std::nth_element(perm.begin() + lo, perm.begin() + mid, perm.begin() + hi,
+                     [pts, axis](quint32 a, quint32 b) { return pts[a][axis] < pts[b][axis]; });
+
+    if (depth < parallelDepth) {
+        QFuture<void> left = QtConcurrent::run([this, node, lo, mid, depth]() { buildNode(2 * node, lo, mid, depth + 1); });
+        buildNode(2 * node + 1, mid, hi, depth + 1);
+        left.waitForFinished();
+    } else {
+        buildNode(2 * node, lo, mid, depth + 1);
+        buildNode(2 * node + 1, mid, hi, depth + 1);
+    }
+
+    const Box &l = boxes[2 * node];
+    const Box &r = boxes[2 * node + 1];
+    for (int a = 0; a < 3; ++a) {
+        box.min[a] = std::min(l.min[a], r.min[a]);
+        box.max[a] = std::max(l.max[a], r.max[a]);
+    }
+}
+
+int PointIndex::pick(const QVector3D &origin, const QVector3D &direction, float radius, float *distance) const
+{
+    if (isEmpty()) return -1;
+
+    const QVector3D inverse(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+    const QVector3D pad(radius, radius, radius);
+    const float radius2 = radius * radius;
+    float best = std::numeric_limits<float>::max();
+    int hit = -1;
+
+    // Depth-first, nearer child first, skipping boxes entered beyond the best hit
+    struct Item { int node, lo, hi; float t; };
+    Item stack[64];
+    int top = 0;
+    float t;
+    if (!rayBox(origin, inverse, boxes[1].min - pad, boxes[1].max + pad, best, t)) return -1;
+    stack[top++] = { 1, 0, perm.size(), t };
+    while (top > 0) {
+        const Item it = stack[--top];
+        if (it.t > best) continue;
+
+        if (isLeaf(it.lo, it.hi)) {
+            for (int i = it.lo; i < it.hi; ++i) {
+                const QVector3D d = points[int(perm[i])] - origin;
+                const float along = QVector3D::dotProduct(d, direction);
+                if (along < 0.0f || along >= best) continue;
+                if (d.lengthSquared() - along * along <= radius2) {
+                    best = along;
+                    hit = int(perm[i]);
+                }
+            }
+            continue;
+        }
+
+        const int mid = it.lo + (it.hi - it.lo) / 2;
+        Item children[2] = { { 2 * it.node, it.lo, mid, 0.0f }, { 2 * it.node + 1, mid, it.hi, 0.0f } };
+        bool ok[2];
+        for (int c = 0; c < 2; ++c)
+            ok[c] = rayBox(origin, inverse, boxes[children[c].node].min - pad, boxes[children[c].node].max + pad, best, children[c].t);
+        // Push the farther one first so the nearer one is popped next
+        const int nearer = ok[0] && ok[1] ? (children[0].t <= children[1].t ? 0 : 1) : (ok[0] ? 0 : 1);
+        if (ok[1 - nearer]) stack[top++] = children[1 - nearer];
+        if (ok[nearer]) stack[top++] = children[nearer];
+    }
+
+    if (hit >= 0 && distance) *distance = best;
+    return hit;
+}
+
+int PointIndex::nearest(const QVector3D &p, float maxDistance) const
+{
+    if (isEmpty()) return -1;
+
+    float best = maxDistance * maxDistance;
+    int hit = -1;
+    struct Item { int node, lo, hi; float d; };
+    Item stack[64];
+    int top = 0;
+    stack[top++] = { 1, 0, perm.size(), boxDistanceSquared(p, boxes[1].min, boxes[1].max) };
+    while (top > 0) {
+        const Item it = stack[--top];
+        if (it.d > best) continue;
+
+        if (isLeaf(it.lo, it.hi)) {
+            for (int i = it.lo; i < it.hi; ++i) {
+                const float d = (points[int(perm[i])] - p).lengthSquared();
+                if (d <= best) {
+                    best = d;
+                    hit = int(perm[i]);
+                }
+            }
+            continue;
+        }
+
+        const int mid = it.lo + (it.hi - it.lo) / 2;
+        Item l = { 2 * it.node, it.lo, mid, boxDistanceSquared(p, boxes[2 * it.node].min, boxes[2 * it.node].max) };
+        Item r = { 2 * it.node + 1, mid, it.hi, boxDistanceSquared(p, boxes[2 * it.node + 1].min, boxes[2 * it.node + 1].max) };
+        if (l.d > r.d) std::swap(l, r);
+        if (r.d <= best) stack[top++] = r;
+        if (l.d <= best) stack[top++] = l;
+    }
+    return hit;
+}
@@ -0,0 +1,50 @@
+#ifndef POINTINDEX_H
+#define POINTINDEX_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Bounding volume hierarchy over a point cloud for picking and nearest
+// point queries.
+//
+// The tree is implicit: every node splits its range of the permutation in
+// half at the median of its longest axis, so children of node k are 2k and
+// 2k + 1 and only one box per node is stored. The halves are independent,
+// so the upper levels are built in parallel on the global thread pool.
+// Positions are shared with the cloud (QVector is implicitly shared), not
+// copied.
+class PointIndex
+{
+public:
+    void build(const QVector<QVector3D> &positions);
+    void clear();
+    bool isEmpty() const { return perm.isEmpty(); }
+    qint64 buildMs() const { return buildTime; }
+
+    // Front-most point within radius of the ray, or -1. direction must be
+    // normalised; *distance gets the distance along the ray.
+    int pick(const QVector3D &origin, const QVector3D &direction, float radius, float *distance = nullptr) const;
+
+    // Closest point to p no further than maxDistance away, or -1
+    int nearest(const QVector3D &p, float maxDistance) const;
+
+private:
+    struct Box
+    {
+        QVector3D min;
+        QVector3D max;
+    };
+
+    void buildNode(int node, int lo, int hi, int depth);
+    bool isLeaf(int lo, int hi) const { return hi - lo <= kLeafSize; }
+
+    static const int kLeafSize = 32;
+
+    QVector<QVector3D> points;
+    QVector<quint32> perm;      // leaf order -> point index
+    QVector<Box> boxes;         // heap order, root is 1
+    int parallelDepth = 0;
+    qint64 buildTime = 0;
+};
+
+#endif // POINTINDEX_H
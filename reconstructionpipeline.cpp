@@ -0,0 +1,449 @@
+#include "reconstructionpipeline.h"
+#include "colmapdatabase.h"
+#include "cameragroups.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace
+{
+    const QStringList imageFilters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tiff"};
+    const int kSnapshotImagesFreq = 50;       // mapper writes a snapshot every N registered images
+    const int kCheckpointIntervalMs = 30000;  // manifest refresh while a stage is running
+
+    bool hasModel(const QString &dir)
+    {
+        QDir d(dir);
+        return d.exists("cameras.bin") && d.exists("images.bin") && d.exists("points3D.bin");
+    }
+}
+
+ReconstructionPipeline::ReconstructionPipeline(const QString &projectFolder, QObject *parent)
+    : QObject(parent), project(projectFolder), cp(projectFolder)
+{
+    cp.load();
+
+    process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ReconstructionPipeline::onProcessFinished);
+    connect(process, &QProcess::readyReadStandardOutput, this, &ReconstructionPipeline::onProcessOutput);
+
+    checkpointTimer = new QTimer(this);
+    checkpointTimer->setInterval(kCheckpointIntervalMs);
+    connect(checkpointTimer, &QTimer::timeout, this, &ReconstructionPipeline::refreshCheckpoint);
+}
+
+ReconstructionPipeline::~ReconstructionPipeline()
+{
+    // Leave the manifest marked as running: this is what a crash looks like too
+    if (isRunning()) {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(2000);
+    }
+}
+
+QString ReconstructionPipeline::stageName(int stage)
+{
+    switch (stage) {
+    case FeatureExtraction: return "Feature extraction";
+    case Matching:          return "Feature matching";
+    case Mapping:           return "Sparse reconstruction";
+    case Undistortion:      return "Image undistortion";
+    case DenseStereo:       return "Dense stereo";
+    case Fusion:            return "Stereo fusion";
+    }
+    return QString();
+}
+
+QString ReconstructionPipeline::databasePath() const { return QDir(project).filePath("database.db"); }
+QString ReconstructionPipeline::sparsePath() const   { return QDir(project).filePath("sparse"); }
+QString ReconstructionPipeline::snapshotPath() const { return QDir(project).filePath("sparse/snapshots"); }
+QString ReconstructionPipeline::densePath() const    { return QDir(project).filePath("dense"); }
+
+bool ReconstructionPipeline::isRunning() const
+{
+    return process->state() != QProcess::NotRunning;
+}
+
+void ReconstructionPipeline::start(int last)
+{
+    if (isRunning()) return;
+
+    cancelled = false;
+    lastStage = qBound(0, last, StageCount - 1);
+    cp.load();   // other tools (sharded extraction) may have moved it on
+    validate();
+    cp.running = true;
+    cp.targetStage = lastStage;
+    cp.save();
+
+    stage = FeatureExtraction;
+    checkpointTimer->start();
+    runNext();
+}
+
+void ReconstructionPipeline::cancel()
+{
+    if (!isRunning()) return;
+    cancelled = true;
+    if (governor) governor->resume();   // a frozen child would sit on SIGTERM
+    process->terminate();
+    QTimer::singleShot(5000, process, [this]() {
+        if (isRunning()) process->kill();
+    });
+}
+
+QStringList ReconstructionPipeline::projectImages() const
+{
+    return QDir(project).entryList(imageFilters, QDir::Files, QDir::Name);
+}
+
+QString ReconstructionPipeline::latestSnapshot() const
+{
+    // Snapshot folders are named by timestamp, so the last one by name is the newest
+    QDir dir(snapshotPath());
+    const QStringList snapshots = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (int i = snapshots.size() - 1; i >= 0; --i) {
+        const QString path = dir.filePath(snapshots[i]);
+        if (hasModel(path)) return path;
+    }
+    return QString();
+}
+
+ReconstructionPipeline::DatabaseProgress ReconstructionPipeline::readDatabase(const QString &db)
+{
+    DatabaseProgress progress;
+    if (!QFileInfo::exists(db)) {
+        progress.ok = true;
+        return progress;
+    }
+    QString error, pairError;
+    progress.imagesWithFeatures = ColmapDatabase::imagesWithFeatures(db, &error);
+    progress.matchedPairs = ColmapDatabase::matchedPairCount(db, &pairError);
+    progress.ok = error.isEmpty() && pairError.isEmpty();
+    return progress;
+}
+
+void ReconstructionPipeline::validate()
+{
+    validate(readDatabase(databasePath()));
+}
+
+// Re-derives the checkpoint from what is actually on disk. Flags recorded
+// in the manifest are only kept if their artifacts still exist, and a stage
+// can never be done if the one before it is not.
+void ReconstructionPipeline::validate(const DatabaseProgress &db)
+{
+    ++validations;
+    const QStringList images = projectImages();
+
+    // A busy database (COLMAP mid-write) keeps the last known values
+    if (db.ok) {
+        cp.imagesWithFeatures = db.imagesWithFeatures;
+        cp.matchedPairs = db.matchedPairs;
+    }
+
+    const QSet<QString> have(cp.imagesWithFeatures.begin(), cp.imagesWithFeatures.end());
+    cp.featuresDone = !images.isEmpty();
+    for (const QString &name : images) {
+        if (!have.contains(name)) {
+            cp.featuresDone = false;
+            break;
+        }
+    }
+
+    cp.matchingDone = cp.matchingDone && cp.featuresDone;
+    cp.sparseSnapshot = cp.matchingDone ? latestSnapshot() : QString();
+    cp.sparseDone = cp.sparseDone && cp.matchingDone && hasModel(QDir(sparsePath()).filePath("0"));
+
+    const QDir stereo(QDir(densePath()).filePath("stereo"));
+    cp.undistortionDone = cp.undistortionDone && cp.sparseDone
+                          && (stereo.exists("patch-match.cfg") || stereo.exists("patch-match.cfg.full"));
+
+    cp.depthMapsDone.clear();
+    cp.depthMapsTotal = 0;
+    if (cp.undistortionDone) {
+        const QStringList undistorted = QDir(QDir(densePath()).filePath("images")).entryList(QDir::Files, QDir::Name);
+        cp.depthMapsTotal = undistorted.size();
+        for (const QString &name : undistorted) {
+            QFileInfo depth(stereo.filePath("depth_maps/" + name + ".geometric.bin"));
+            if (depth.exists() && depth.size() > 0)
+                cp.depthMapsDone << name;
+        }
+    }
+
+    cp.fusionDone = cp.fusionDone && isComplete(DenseStereo)
+                    && QFileInfo::exists(QDir(densePath()).filePath("fused.ply"));
+}
+
+bool ReconstructionPipeline::isComplete(int s) const
+{
+    switch (s) {
+    case FeatureExtraction: return cp.featuresDone;
+    case Matching:          return cp.matchingDone;
+    case Mapping:           return cp.sparseDone;
+    case Undistortion:      return cp.undistortionDone;
+    case DenseStereo:       return cp.undistortionDone && cp.depthMapsTotal > 0
+                                   && cp.depthMapsDone.size() == cp.depthMapsTotal;
+    case Fusion:            return cp.fusionDone;
+    }
+    return false;
+}
+
+QString ReconstructionPipeline::writeImageList(const QString &name, const QStringList &images) const
+{
+    const QString path = QDir(project).filePath(".voxelforge/" + name);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile list(path);
+    if (!list.open(QIODevice::WriteOnly)) return QString();
+    list.write((images.join('\n') + '\n').toUtf8());
+    return list.commit() ? path : QString();
+}
+
+// One feature_extractor run per camera group that still has images without
+// features. Each run gets single_camera so the group shares one camera, and
+// the EXIF focal length as the intrinsics prior when there is one. A resumed
+// group gets a second camera from its second run; onProcessFinished folds
+// them back together once the stage is done.
+QList<QStringList> ReconstructionPipeline::featureExtractionCommands(QString *detail)
+{
+    const QStringList images = projectImages();
+
+    // Group images that were copied in without going through the Image Manager
+    CameraGroups groups(project);
+    groups.load();
+    if (groups.addMissing(images))
+        groups.save();
+
+    const QSet<QString> present(images.begin(), images.end());
+    const QSet<QString> have(cp.imagesWithFeatures.begin(), cp.imagesWithFeatures.end());
+    QList<QStringList> commands;
+    int left = 0;
+    for (const CameraGroup &g : groups.groups()) {
+        QStringList missing;
+        for (const QString &name : g.images)
+            if (present.contains(name) && !have.contains(name)) missing << name;
+        if (missing.isEmpty()) continue;
+
+        const QString listPath = writeImageList(QString("pending_%1.txt").arg(g.id), missing);
+        if (listPath.isEmpty()) continue;
+        left += missing.size();
+
+        QStringList args{ "feature_extractor", "--database_path", databasePath(), "--image_path", project,
+                          "--image_list_path", listPath };
+        if (g.sharesCamera())
+            args << "--ImageReader.single_camera" << "1";
+        const QString params = g.cameraParams();
+        if (!params.isEmpty())
+            args << "--ImageReader.camera_model" << "SIMPLE_RADIAL" << "--ImageReader.camera_params" << params;
+        commands << args;
+    }
+
+    *detail = QString("%1 of %2 images left, %3 camera group(s)").arg(left).arg(images.size()).arg(commands.size());
+    return commands;
+}
+
+// Command line for a stage, narrowed down to the work that is still missing
+QStringList ReconstructionPipeline::argumentsFor(int s, QString *detail)
+{
+    const QString db = databasePath();
+    QStringList args;
+
+    switch (s) {
+    case Matching:
+        // The checkpoint only counts matched pairs, it does not know which
+        // ones are done, so an interrupted matching stage runs again in full
+        args << "exhaustive_matcher" << "--database_path" << db;
+        break;
+    case Mapping:
+        QDir().mkpath(snapshotPath());
+        args << "mapper" << "--database_path" << db << "--image_path" << project
+             << "--Mapper.snapshot_path" << snapshotPath()
+             << "--Mapper.snapshot_images_freq" << QString::number(kSnapshotImagesFreq);
+        if (!cp.sparseSnapshot.isEmpty()) {
+            const QString model = QDir(sparsePath()).filePath("0");
+            QDir().mkpath(model);
+            args << "--input_path" << cp.sparseSnapshot << "--output_path" << model;
+            *detail = "resuming from snapshot " + QFileInfo(cp.sparseSnapshot).fileName();
+        } else {
+            args << "--output_path" << sparsePath();
+        }
+        break;
+    case Undistortion:
+        QDir().mkpath(densePath());
+        args << "image_undistorter" << "--image_path" << project
+             << "--input_path" << QDir(sparsePath()).filePath("0")
+             << "--output_path" << densePath() << "--output_type" << "COLMAP";
+        break;
+    case DenseStereo: {
+        if (!cp.depthMapsDone.isEmpty()) {
+            // Point patch-match.cfg at the images without depth maps; the
+            // full config is put back once the stage ends
+            const QString cfg = QDir(densePath()).filePath("stereo/patch-match.cfg");
+            const QString full = cfg + ".full";
+            if (!QFileInfo::exists(full))
+                QFile::copy(cfg, full);
+
+            const QSet<QString> done(cp.depthMapsDone.begin(), cp.depthMapsDone.end());
+            QSaveFile out(cfg);
+            if (out.open(QIODevice::WriteOnly)) {
+                int left = 0;
+                for (const QString &name : QDir(QDir(densePath()).filePath("images")).entryList(QDir::Files, QDir::Name)) {
+                    if (done.contains(name)) continue;
+                    out.write((name + "\n__auto__, 20\n").toUtf8());
+                    ++left;
+                }
+                out.commit();
+                *detail = QString("%1 of %2 depth maps left").arg(left).arg(cp.depthMapsTotal);
+            }
+        }
+        args << "patch_match_stereo" << "--workspace_path" << densePath()
+             << "--workspace_format" << "COLMAP" << "--PatchMatchStereo.geom_consistency" << "true";
+        break;
+    }
+    case Fusion:
+        args << "stereo_fusion" << "--workspace_path" << densePath()
+             << "--workspace_format" << "COLMAP" << "--input_type" << "geometric"
+             << "--output_path" << QDir(densePath()).filePath("fused.ply");
+        break;
+    }
+    return args;
+}
+
+void ReconstructionPipeline::restorePatchMatchConfig()
+{
+    const QString cfg = QDir(densePath()).filePath("stereo/patch-match.cfg");
+    const QString full = cfg + ".full";
+    if (!QFileInfo::exists(full)) return;
+    QFile::remove(cfg);
+    QFile::rename(full, cfg);
+}
+
+void ReconstructionPipeline::runNext()
+{
+    while (stage <= lastStage) {
+        if (isComplete(stage)) {
+            emit logMessage(stageName(stage) + ": already done, skipping");
+            ++stage;
+            continue;
+        }
+
+        QString detail;
+        pendingCommands = stage == FeatureExtraction ? featureExtractionCommands(&detail)
+                                                     : QList<QStringList>{ argumentsFor(stage, &detail) };
+        if (pendingCommands.isEmpty()) {
+            finish(false, projectImages().isEmpty() ? "The project folder has no images"
+                                                    : stageName(stage) + ": nothing could be scheduled");
+            return;
+        }
+        emit stageStarted(stage, detail);
+        startNextCommand();
+        return;
+    }
+    finish(true, "Reconstruction finished");
+}
+
+void ReconstructionPipeline::startNextCommand()
+{
+    const QStringList args = pendingCommands.takeFirst();
+    emit logMessage("colmap " + args.join(' '));
+    process->setWorkingDirectory(project);
+    if (governor)
+        governor->start(process, "colmap", args, stage);
+    else
+        process->start("colmap", args);
+}
+
+void ReconstructionPipeline::onProcessOutput()
+{
+    while (process->canReadLine())
+        emit logMessage(QString::fromLocal8Bit(process->readLine()).trimmed());
+}
+
+void ReconstructionPipeline::onProcessFinished(int exitCode, QProcess::ExitStatus status)
+{
+    if (stage == DenseStereo)
+        restorePatchMatchConfig();
+
+    if (cancelled) {
+        validate();
+        finish(false, "Cancelled");
+        return;
+    }
+    if (status != QProcess::NormalExit || exitCode != 0) {
+        validate();
+        finish(false, QString("%1 failed (exit code %2)").arg(stageName(stage)).arg(exitCode));
+        return;
+    }
+
+    if (!pendingCommands.isEmpty()) {
+        startNextCommand();
+        return;
+    }
+
+    if (stage == FeatureExtraction) {
+        CameraGroups groups(project);
+        groups.load();
+        QString error;
+        if (!groups.shareCameras(databasePath(), &error)) {
+            finish(false, "Could not merge the cameras of each camera group: " + error);
+            return;
+        }
+    }
+
+    // These stages leave nothing that can be checked cheaply for partial
+    // completion, so a clean exit is what marks them done
+    switch (stage) {
+    case Matching:     cp.matchingDone = true; break;
+    case Mapping:      cp.sparseDone = true; break;
+    case Undistortion: cp.undistortionDone = true; break;
+    case Fusion:       cp.fusionDone = true; break;
+    }
+    validate();
+    if (!isComplete(stage)) {
+        finish(false, QString("%1 finished but its output is incomplete").arg(stageName(stage)));
+        return;
+    }
+
+    cp.save();
+    emit stageFinished(stage);
+    ++stage;
+    runNext();
+}
+
+// Periodic refresh while a stage runs. The database queries can wait on
+// COLMAP's write lock for the whole busy timeout, so they run on the pool
+// and the result is applied here unless a stage change validated since.
+void ReconstructionPipeline::refreshCheckpoint()
+{
+    if (checkpointWatcher) return;   // the last read is still waiting on the database
+
+    const int generation = validations;
+    checkpointWatcher = new QFutureWatcher<DatabaseProgress>(this);
+    connect(checkpointWatcher, &QFutureWatcher<DatabaseProgress>::finished, this, [this, generation]() {
+        const DatabaseProgress progress = checkpointWatcher->result();
+        checkpointWatcher->deleteLater();
+        checkpointWatcher = nullptr;
+        if (generation != validations || !cp.running) return;
+        validate(progress);
+        cp.save();
+    });
+    checkpointWatcher->setFuture(QtConcurrent::run(&ReconstructionPipeline::readDatabase, databasePath()));
+}
+
+void ReconstructionPipeline::finish(bool ok, const QString &message)
+{
+    checkpointTimer->stop();
+    pendingCommands.clear();
+    cp.running = false;
+    cp.save();
+    stage = StageCount;
+    emit finished(ok, message);
+}
@@ -0,0 +1,100 @@
+#ifndef RECONSTRUCTIONPIPELINE_H
+#define RECONSTRUCTIONPIPELINE_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QPointer>
+#include <QFutureWatcher>
+#include "pipelinecheckpoint.h"
+#include "resourcegovernor.h"
+
+class QTimer;
+
+// Runs the COLMAP command line stages for a project folder, one child
+// process at a time, and keeps a PipelineCheckpoint up to date so an
+// interrupted run can pick up at the first unit of work that is missing.
+//
+// Project layout (everything relative to the project folder):
+//   *.jpg, *.png ...        input images (what the Image Manager copies in)
+//   database.db             features and matches
+//   sparse/0                sparse model, sparse/snapshots for mapper snapshots
+//   dense/                  undistorted workspace, depth maps and fused.ply
+class ReconstructionPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage { FeatureExtraction, Matching, Mapping, Undistortion, DenseStereo, Fusion, StageCount };
+
+    explicit ReconstructionPipeline(const QString &projectFolder, QObject *parent = nullptr);
+    ~ReconstructionPipeline() override;
+
+    static QString stageName(int stage);
+
+    // Runs every stage up to and including lastStage. Work the checkpoint
+    // and the files on disk show as finished is skipped.
+    void start(int lastStage);
+    void cancel();
+    bool isRunning() const;
+    int currentStage() const { return stage; }
+
+    const PipelineCheckpoint &checkpoint() const { return cp; }
+
+    // Children are started under the governor's limits when one is set
+    void setGovernor(ResourceGovernor *g) { governor = g; }
+
+    QString projectFolder() const { return project; }
+    QString databasePath() const;
+    QString sparsePath() const;
+    QString snapshotPath() const;
+    QString densePath() const;
+
+signals:
+    void stageStarted(int stage, const QString &detail);
+    void stageFinished(int stage);
+    void logMessage(const QString &line);
+    void finished(bool ok, const QString &message);
+
+private slots:
+    void onProcessFinished(int exitCode, QProcess::ExitStatus status);
+    void onProcessOutput();
+    void refreshCheckpoint();
+
+private:
+    // What the database says; read off the GUI thread while COLMAP writes to it
+    struct DatabaseProgress
+    {
+        QStringList imagesWithFeatures;
+        qint64 matchedPairs = 0;
+        bool ok = false;           // false if the database was busy or unreadable
+    };
+    static DatabaseProgress readDatabase(const QString &databasePath);
+
+    void validate();
+    void validate(const DatabaseProgress &db);
+    bool isComplete(int stage) const;
+    void runNext();
+    QStringList argumentsFor(int stage, QString *detail);
+    QList<QStringList> featureExtractionCommands(QString *detail);
+    QString writeImageList(const QString &name, const QStringList &images) const;
+    void startNextCommand();
+    QStringList projectImages() const;
+    QString latestSnapshot() const;
+    void restorePatchMatchConfig();
+    void finish(bool ok, const QString &message);
+
+    QString project;
+    PipelineCheckpoint cp;
+    QProcess *process = nullptr;
+    QPointer<ResourceGovernor> governor;
+    QTimer *checkpointTimer = nullptr;
+    QFutureWatcher<DatabaseProgress> *checkpointWatcher = nullptr;   // periodic read in flight
+    int validations = 0;          // bumped by every validate(); stale reads are dropped
+    QList<QStringList> pendingCommands;   // the rest of the current stage
+    int stage = StageCount;
+    int lastStage = StageCount;
+    bool cancelled = false;
+};
+
+#endif // RECONSTRUCTIONPIPELINE_H
@@ -0,0 +1,382 @@
+#include "resourcegovernor.h"
+#include "reconstructionpipeline.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QFile>
+#include <QFileInfo>
+#include <QMouseEvent>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
+
+namespace
+{
+    const int kSampleIntervalMs = 1000;
+    const int kHeartbeatMs = 50;
+    const int kLatencyBudgetMs = 50;      // GUI wake-ups later than this count as a stutter
+    const int kResumeAfterIdleMs = 1200;  // thaw this long after the last input event
+    const int kMaxPauseMs = 8000;         // never hold a stage longer than this in one go
+    const int kCooldownMs = 20000;        // no new pause for this long after a forced resume
+    const int kCpuWeight = 20;            // cgroup cpu.weight, the default is 100
+
+    // Writes cgroup.freeze of the cgroup v2 group the process is in. It is
+    // synchronous, so a thaw can never overtake the freeze before it, as two
+    // detached systemctl calls can.
+    bool setFrozen(qint64 pid, bool frozen)
+    {
+        QFile proc(QString("/proc/%1/cgroup").arg(pid));
+        if (!proc.open(QIODevice::ReadOnly)) return false;
+        const QList<QByteArray> lines = proc.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (!line.startsWith("0::")) continue;
+            QFile freeze("/sys/fs/cgroup" + QString::fromUtf8(line.mid(3).trimmed()) + "/cgroup.freeze");
+            return freeze.open(QIODevice::WriteOnly) && freeze.write(frozen ? "1" : "0") == 1;
+        }
+        return false;
+    }
+
+    int reservedCores()
+    {
+        const int cores = QThread::idealThreadCount();
+        return cores >= 8 ? 2 : (cores > 1 ? 1 : 0);
+    }
+
+    // Parses "some avg10=1.23 ..." / "full avg10=..." lines of a /proc/pressure file
+    bool readPsi(const QString &path, double *some, double *full)
+    {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) return false;
+        const QList<QByteArray> lines = f.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            const int at = line.indexOf("avg10=");
+            if (at < 0) continue;
+            const double value = line.mid(at + 6, line.indexOf(' ', at) - at - 6).toDouble();
+            if (line.startsWith("some") && some) *some = value;
+            if (line.startsWith("full") && full) *full = value;
+        }
+        return true;
+    }
+
+    // Scheduling priority per stage. Dense stereo mostly waits on the GPU;
+    // its feeder threads need the CPU promptly or the GPU idles.
+    int niceness(int stage)
+    {
+        return stage == ReconstructionPipeline::DenseStereo ? 5 : 10;
+    }
+}
+
+ResourceGovernor::ResourceGovernor(QObject *parent)
+    : QObject(parent)
+{
+    maxQuota = qMax(1, QThread::idealThreadCount() - reservedCores()) * 100;
+    quota = maxQuota;
+
+    sampleTimer = new QTimer(this);
+    sampleTimer->setInterval(kSampleIntervalMs);
+    connect(sampleTimer, &QTimer::timeout, this, &ResourceGovernor::sample);
+
+    heartbeatTimer = new QTimer(this);
+    heartbeatTimer->setTimerType(Qt::PreciseTimer);
+    heartbeatTimer->setInterval(kHeartbeatMs);
+    connect(heartbeatTimer, &QTimer::timeout, this, &ResourceGovernor::heartbeat);
+
+    interactionTimer = new QTimer(this);
+    interactionTimer->setInterval(250);
+    connect(interactionTimer, &QTimer::timeout, this, &ResourceGovernor::checkInteraction);
+
+    probeCgroups();
+}
+
+ResourceGovernor::~ResourceGovernor()
+{
+    // Never leave a child frozen behind us
+    resume();
+}
+
+ResourceGovernor::Pressure ResourceGovernor::readPressure()
+{
+    Pressure p;
+    p.available = readPsi("/proc/pressure/cpu", &p.cpuSome, nullptr);
+    readPsi("/proc/pressure/memory", &p.memorySome, &p.memoryFull);
+    readPsi("/proc/pressure/io", &p.ioSome, nullptr);
+
+    QFile load("/proc/loadavg");
+    if (load.open(QIODevice::ReadOnly))
+        p.load1 = load.readAll().split(' ').value(0).toDouble();
+    return p;
+}
+
+// cgroup v2 plus a systemd user manager that accepts transient scopes.
+// Probed once, without waiting: a slow or hung user manager must not hold
+// up the GUI, so the probe gets 3 s and is killed after that.
+void ResourceGovernor::probeCgroups()
+{
+    if (!QFileInfo::exists("/sys/fs/cgroup/cgroup.controllers")) return;
+    if (QStandardPaths::findExecutable("systemd-run").isEmpty()
+        || QStandardPaths::findExecutable("systemctl").isEmpty()) {
+        return;
+    }
+
+    QProcess *probe = new QProcess(this);
+    connect(probe, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this, probe](int exitCode, QProcess::ExitStatus status) {
+        cgroups = status == QProcess::NormalExit && exitCode == 0;
+        probe->deleteLater();
+    });
+    connect(probe, &QProcess::errorOccurred, probe, [probe](QProcess::ProcessError e) {
+        if (e == QProcess::FailedToStart) probe->deleteLater();
+    });
+    QTimer::singleShot(3000, probe, [probe]() { probe->kill(); });
+    probe->start("systemd-run", { "--user", "--scope", "--quiet", "--collect", "true" });
+}
+
+int ResourceGovernor::threadsFor(int stage) const
+{
+    const int cores = QThread::idealThreadCount();
+    int threads = qMax(1, cores - reservedCores());
+
+    const Pressure p = readPressure();
+    if (p.available) {
+        // Others are already queueing for CPU: take a smaller share
+        if (p.cpuSome > 50.0)
+            threads = threads * 2 / 3;
+        // Fewer threads means fewer images and patches resident at once
+        const bool memoryHungry = stage == ReconstructionPipeline::Mapping
+                                  || stage == ReconstructionPipeline::DenseStereo
+                                  || stage == ReconstructionPipeline::Fusion;
+        if (memoryHungry && (p.memoryFull > 5.0 || p.memorySome > 20.0))
+            threads /= 2;
+    }
+    if (p.load1 > cores)
+        threads = int(threads * cores / p.load1);
+    return qMax(1, threads);
+}
+
+QStringList ResourceGovernor::threadArguments(int stage, int threads)
+{
+    const QString n = QString::number(threads);
+    switch (stage) {
+    case ReconstructionPipeline::FeatureExtraction: return { "--SiftExtraction.num_threads", n };
+    case ReconstructionPipeline::Matching:          return { "--SiftMatching.num_threads", n };
+    case ReconstructionPipeline::Mapping:           return { "--Mapper.num_threads", n };
+    case ReconstructionPipeline::Fusion:            return { "--StereoFusion.num_threads", n };
+    }
+    // image_undistorter has no thread option and patch_match_stereo runs on the GPU
+    return {};
+}
+
+void ResourceGovernor::start(QProcess *process, const QString &program, const QStringList &arguments, int stage)
+{
+    forget(process);   // a reused QProcess starts a new child
+
+    QStringList args = arguments;
+    const QStringList threadArgs = threadArguments(stage, threadsFor(stage));
+    if (QFileInfo(program).baseName() == "colmap" && !threadArgs.isEmpty() && !args.contains(threadArgs.first()))
+        args << threadArgs;
+
+    if (children.isEmpty()) {
+        quota = maxQuota;
+        worstLatencyMs = 0;
+        heartbeatClock.start();
+        sampleTimer->start();
+        heartbeatTimer->start();
+        interactionTimer->start();
+        qApp->installEventFilter(this);
+    }
+
+    // Each wrapper execs the next, so the pid QProcess sees is the child's own
+    QStringList command;
+    Child child;
+    child.process = process;
+    child.stage = stage;
+    child.direct = QFileInfo(program).baseName() == "colmap";
+    if (cgroupsAvailable()) {
+        const QString unit = QString("voxelforge-%1-%2").arg(QCoreApplication::applicationPid()).arg(++unitCounter);
+        child.unit = unit + ".scope";
+        int scopes = 1;
+        for (const Child &c : children)
+            if (!c.unit.isEmpty()) ++scopes;
+        // MemoryHigh throttles and reclaims instead of killing, so the
+        // desktop keeps its memory without COLMAP dying at the limit
+        command << "systemd-run" << "--user" << "--scope" << "--quiet" << "--collect" << "--unit=" + unit
+                << "-p" << QString("CPUWeight=%1").arg(kCpuWeight)
+                << "-p" << QString("CPUQuota=%1%").arg(scopeQuota(scopes))
+                << "-p" << "MemoryHigh=85%";
+    }
+    const QString nice = QStandardPaths::findExecutable("nice");
+    if (!nice.isEmpty())
+        command << nice << "-n" << QString::number(niceness(stage));
+    const QString ionice = QStandardPaths::findExecutable("ionice");
+    if (!ionice.isEmpty())
+        command << ionice << "-c" << "2" << "-n" << "7";
+    // The child of QProcess is never a group leader, so setsid execs in place
+    const QString setsid = QStandardPaths::findExecutable("setsid");
+    if (!setsid.isEmpty()) {
+        command << setsid;
+        child.group = true;
+    }
+    command << program << args;
+
+    children << child;
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, process]() {
+        forget(process);
+    });
+    process->start(command.takeFirst(), command);
+
+    // The scopes already running give up part of their share to the new one
+    if (!child.unit.isEmpty())
+        setQuota(quota);
+}
+
+void ResourceGovernor::forget(QProcess *process)
+{
+    for (int i = children.size() - 1; i >= 0; --i) {
+        if (!children[i].process || children[i].process == process)
+            children.removeAt(i);
+    }
+    if (process)
+        disconnect(process, nullptr, this, nullptr);
+
+    if (children.isEmpty()) {
+        sampleTimer->stop();
+        heartbeatTimer->stop();
+        interactionTimer->stop();
+        qApp->removeEventFilter(this);
+        paused = false;
+    } else {
+        setQuota(quota);   // the ones left share what it had
+    }
+}
+
+void ResourceGovernor::heartbeat()
+{
+    const qint64 late = heartbeatClock.restart() - kHeartbeatMs;
+    worstLatencyMs = qMax(worstLatencyMs, late);
+}
+
+// Closed loop on the CPU quota: back off quickly when the GUI stutters or
+// memory / IO pressure builds, give it back slowly when things are calm
+void ResourceGovernor::sample()
+{
+    const qint64 latency = worstLatencyMs;
+    worstLatencyMs = 0;
+    if (paused) return;   // frozen children say nothing about what they cost
+
+    const Pressure p = readPressure();
+    const bool starved = latency > kLatencyBudgetMs
+                         || (p.available && (p.memoryFull > 10.0 || p.ioSome > 60.0));
+    const bool calm = latency < kLatencyBudgetMs / 2 && (!p.available || (p.memoryFull < 2.0 && p.ioSome < 30.0));
+
+    int next = quota;
+    if (starved)
+        next = qMax(100, quota * 3 / 4);
+    else if (calm)
+        next = qMin(maxQuota, quota + qMax(100, maxQuota / 10));
+    if (next != quota)
+        setQuota(next);
+}
+
+// quota is the budget for all children together; each scope gets an equal
+// part, so N shard workers still leave the reserved cores to the GUI
+int ResourceGovernor::scopeQuota(int scopes) const
+{
+    return qMax(1, quota / qMax(1, scopes));
+}
+
+void ResourceGovernor::setQuota(int percent)
+{
+    const bool lowered = percent < quota;
+    quota = percent;
+
+    int scopes = 0;
+    for (const Child &c : children)
+        if (!c.unit.isEmpty()) ++scopes;
+    for (const Child &c : children) {
+        if (c.unit.isEmpty()) continue;
+        QProcess::startDetached("systemctl", { "--user", "set-property", "--runtime", c.unit,
+                                               QString("CPUQuota=%1%").arg(scopeQuota(scopes)) });
+    }
+    const bool scoped = scopes > 0;
+    if (scoped && lowered)
+        emit message(QString("Reconstruction limited to %1 core(s) to keep the desktop responsive")
+                         .arg(percent / 100.0, 0, 'f', 1));
+}
+
+bool ResourceGovernor::eventFilter(QObject *watched, QEvent *event)
+{
+    bool input = false;
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::KeyPress:
+    case QEvent::Wheel:
+    case QEvent::TouchBegin:
+    case QEvent::TouchUpdate:
+        input = true;
+        break;
+    case QEvent::MouseMove:
+        // Hovering is not work; dragging is
+        input = static_cast<QMouseEvent *>(event)->buttons() != Qt::NoButton;
+        break;
+    default:
+        break;
+    }
+
+    if (input) {
+        lastInput.restart();
+        if (pauseOnInteraction && !paused && !children.isEmpty()
+            && (!cooldown.isValid() || cooldown.elapsed() > kCooldownMs)) {
+            pause();
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void ResourceGovernor::checkInteraction()
+{
+    if (!paused) return;
+    if (lastInput.elapsed() >= kResumeAfterIdleMs) {
+        resume();
+    } else if (pausedFor.elapsed() >= kMaxPauseMs) {
+        resume();
+        cooldown.start();
+    }
+}
+
+void ResourceGovernor::pause()
+{
+    paused = true;
+    pausedFor.start();
+    signalChildren(true);
+}
+
+void ResourceGovernor::resume()
+{
+    if (!paused) return;
+    paused = false;
+    signalChildren(false);
+}
+
+// Both levers reach grandchildren (shard workers run COLMAP themselves)
+// and act before this returns, so pause, resume and a cancel's SIGTERM
+// always land in order. A child leading its own process group is stopped
+// by signalling the group; otherwise its scope is frozen directly. Without
+// either only a child that is COLMAP itself is stopped: stopping a shard
+// worker alone would leave its COLMAP running and its socket unanswered.
+void ResourceGovernor::signalChildren(bool stop)
+{
+    for (const Child &c : children) {
+        if (!c.process || c.process->state() != QProcess::Running) continue;
+#ifdef Q_OS_UNIX
+        const pid_t pid = pid_t(c.process->processId());
+        if (c.group)
+            ::kill(-pid, stop ? SIGSTOP : SIGCONT);
+        else if ((c.unit.isEmpty() || !setFrozen(pid, stop)) && c.direct)
+            ::kill(pid, stop ? SIGSTOP : SIGCONT);
+#endif
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef RESOURCEGOVERNOR_H
+#define RESOURCEGOVERNOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QProcess>
+#include <QStringList>
+
+class QTimer;
+
+// Keeps the machine usable while COLMAP runs.
+//
+// Every pipeline child is started through start(), which
+//  - puts it in its own cgroup v2 scope (systemd-run --user --scope) with a
+//    low CPU weight, a share of one CPU quota that leaves cores for the GUI,
+//    and a soft memory limit, when cgroups and a systemd user manager are
+//    available;
+//  - makes it a process group leader (setsid), so a pause reaches whatever
+//    it runs itself, e.g. a shard worker's COLMAP;
+//  - runs it under nice and ionice, so the scheduler and the disk prefer
+//    everything else on the workstation;
+//  - sizes its thread pool for the stage from the core count, the load
+//    average and the CPU and memory pressure (PSI, /proc/pressure).
+//
+// While children run, the governor samples PSI and how late the GUI event
+// loop wakes up once a second. It lowers the scopes' CPU quota when the
+// GUI is being starved and raises it again when things are quiet. It also
+// freezes the children while the user is clicking, dragging or typing,
+// and thaws them a moment after input stops. A pause is capped so a busy
+// user cannot stall a run indefinitely.
+//
+// Everything is best effort: without cgroups, nice or ionice the
+// corresponding lever is skipped, and on non-Linux hosts only the thread
+// counts apply.
+class ResourceGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Pressure stall information: share of time some/all tasks waited, avg10, 0..100
+    struct Pressure
+    {
+        bool available = false;
+        double cpuSome = 0.0;
+        double memorySome = 0.0;
+        double memoryFull = 0.0;
+        double ioSome = 0.0;
+        double load1 = 0.0;
+    };
+
+    explicit ResourceGovernor(QObject *parent = nullptr);
+    ~ResourceGovernor() override;
+
+    static Pressure readPressure();
+
+    // False until the background probe started by the constructor has
+    // confirmed cgroup v2 and a systemd user manager; children started
+    // before that simply run without a scope
+    bool cgroupsAvailable() const { return cgroups; }
+
+    // Threads a stage (ReconstructionPipeline::Stage) should use right now
+    int threadsFor(int stage) const;
+
+    // COLMAP option that sets the thread count of a stage, empty if it has none
+    static QStringList threadArguments(int stage, int threads);
+
+    // Starts program under the governor's limits. Thread arguments are
+    // added for COLMAP stages unless the caller already set them.
+    void start(QProcess *process, const QString &program, const QStringList &arguments, int stage);
+
+    void setPauseOnInteraction(bool on) { pauseOnInteraction = on; }
+    bool isPaused() const { return paused; }
+
+    // Thaws everything now, e.g. before the children are terminated
+    void resume();
+
+signals:
+    void message(const QString &text);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void sample();
+    void heartbeat();
+    void checkInteraction();
+
+private:
+    struct Child
+    {
+        QPointer<QProcess> process;
+        QString unit;          // systemd scope, empty when not in one
+        bool group = false;    // leads its own process group
+        bool direct = false;   // the pid is the program itself, it runs nothing else
+        int stage = -1;
+    };
+
+    void probeCgroups();
+    void pause();
+    void setQuota(int percent);
+    int scopeQuota(int scopes) const;
+    void signalChildren(bool stop);
+    void forget(QProcess *process);
+
+    QList<Child> children;
+    int unitCounter = 0;
+
+    QTimer *sampleTimer = nullptr;
+    QTimer *heartbeatTimer = nullptr;
+    QTimer *interactionTimer = nullptr;
+    QElapsedTimer heartbeatClock;
+    qint64 worstLatencyMs = 0;       // in the current sample window
+
+    int maxQuota = 100;              // percent of one core, for all cores but the reserved ones
+    int quota = 100;                 // shared by every scope, see scopeQuota()
+    bool cgroups = false;
+
+    bool pauseOnInteraction = true;
+    bool paused = false;
+    QElapsedTimer lastInput;
+    QElapsedTimer pausedFor;
+    QElapsedTimer cooldown;          // after a forced resume
+};
+
+#endif // RESOURCEGOVERNOR_H
@@ -0,0 +1,394 @@
+#include "sessionsnapshot.h"
+#include "pipelinecheckpoint.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QByteArray>
+#include <QPair>
+#include <QIconEngine>
+#include <QPainter>
+#include <QPixmap>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+// session.vfs layout, all integers little endian:
+//
+//   Header (64 bytes)
+//     char[4] magic "VFSS"   u32 version          u32 entryCount       u32 pipelineFlags
+//     u32 imagesWithFeatures u32 depthMapsDone    u32 depthMapsTotal   u32 reserved
+//     u64 packSize           u64 entriesOffset    u64 stringsOffset
+//     u32 folderOffset       u32 folderLength
+//   Entries (80 bytes each)
+//     u32 nameOffset  u32 nameLength  u32 pathOffset  u32 pathLength
+//     u32 groupOffset u32 groupLength u32 width       u32 height
+//     u64 thumbOffset u32 thumbLength u32 flags (bit 0 = selected)
+//     i64 captureTime (ms, camera wall clock as UTC; INT64_MIN = unknown)
+//     f64 latitude    f64 longitude  (NaN = no GPS)
+//     f32 sharpness   (< 0 = unknown) u32 reserved
+//   String table: UTF-8, offsets relative to stringsOffset
+//
+// packSize is the size thumbnails.pack had when the snapshot was written.
+// The pack only grows between compactions, so a smaller pack means the
+// snapshot is stale.
+
+namespace
+{
+    const char kMagic[4] = { 'V', 'F', 'S', 'S' };
+    const int kHeaderSize = 64;
+    const int kEntrySize = 80;
+
+    enum PipelineFlag : quint32 {
+        FeaturesDone = 1 << 0,
+        MatchingDone = 1 << 1,
+        SparseDone = 1 << 2,
+        UndistortionDone = 1 << 3,
+        FusionDone = 1 << 4,
+    };
+
+    template <typename T>
+    T get(const uchar *p)
+    {
+        return qFromLittleEndian<T>(p);
+    }
+
+    template <typename T>
+    void put(QByteArray &out, T v)
+    {
+        const T le = qToLittleEndian(v);
+        out.append(reinterpret_cast<const char *>(&le), sizeof(T));
+    }
+
+    // Collects strings for the table and hands back (offset, length)
+    class StringTable
+    {
+    public:
+        QPair<quint32, quint32> add(const QString &s)
+        {
+            const QByteArray utf8 = s.toUtf8();
+            const quint32 offset = quint32(bytes.size());
+            bytes += utf8;
+            return { offset, quint32(utf8.size()) };
+        }
+        QByteArray bytes;
+    };
+}
+
+// Memory-mapped thumbnails.pack, shared by every lazy icon that points into it
+class ThumbnailPack
+{
+public:
+    explicit ThumbnailPack(const QString &path) : file(path)
+    {
+        if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+            size = file.size();
+            data = file.map(0, size);
+        }
+    }
+    ~ThumbnailPack()
+    {
+        if (data) file.unmap(const_cast<uchar *>(data));
+    }
+
+    QImage decode(qint64 offset, int length) const
+    {
+        if (!data || offset < 0 || length <= 0 || offset + length > size) return QImage();
+        return QImage::fromData(data + offset, length, "JPG");
+    }
+
+    QFile file;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+};
+
+namespace
+{
+    // Decodes its thumbnail the first time it is painted
+    class PackedIconEngine : public QIconEngine
+    {
+    public:
+        PackedIconEngine(QSharedPointer<ThumbnailPack> p, qint64 off, int len)
+            : pack(p), offset(off), length(len) {}
+
+        void paint(QPainter *painter, const QRect &rect, QIcon::Mode, QIcon::State) override
+        {
+            const QPixmap pm = loaded();
+            if (pm.isNull()) return;
+            const QSize s = pm.size().scaled(rect.size(), Qt::KeepAspectRatio);
+            painter->drawPixmap(QRect(rect.center() - QPoint(s.width() / 2, s.height() / 2), s), pm);
+        }
+
+        QPixmap pixmap(const QSize &size, QIcon::Mode, QIcon::State) override
+        {
+            const QPixmap pm = loaded();
+            if (pm.isNull() || pm.size() == size) return pm;
+            return pm.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+
+        QSize actualSize(const QSize &size, QIcon::Mode, QIcon::State) override
+        {
+            // Answer from the JPEG header would still mean touching the pack; the
+            // grid only needs an upper bound
+            return size;
+        }
+
+        QIconEngine *clone() const override
+        {
+            return new PackedIconEngine(pack, offset, length);
+        }
+
+    private:
+        QPixmap loaded()
+        {
+            if (cache.isNull() && pack)
+                cache = QPixmap::fromImage(pack->decode(offset, length));
+            return cache;
+        }
+
+        QSharedPointer<ThumbnailPack> pack;
+        qint64 offset;
+        int length;
+        QPixmap cache;
+    };
+}
+
+SessionSnapshot::~SessionSnapshot()
+{
+    close();
+}
+
+QString SessionSnapshot::snapshotPath(const QString &projectFolder)
+{
+    return QDir(projectFolder).filePath(".voxelforge/session.vfs");
+}
+
+QString SessionSnapshot::packPath(const QString &projectFolder)
+{
+    return QDir(projectFolder).filePath(".voxelforge/thumbnails.pack");
+}
+
+bool SessionSnapshot::open(const QString &projectFolder)
+{
+    close();
+
+    file.setFileName(snapshotPath(projectFolder));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    size = file.size();
+    if (size < kHeaderSize) {
+        close();
+        return false;
+    }
+    data = file.map(0, size);
+    if (!data) {
+        close();
+        return false;
+    }
+
+    const quint32 n = get<quint32>(data + 8);
+    const quint64 entriesOffset = get<quint64>(data + 40);
+    const quint64 stringsOffset = get<quint64>(data + 48);
+    const bool ok = std::memcmp(data, kMagic, 4) == 0
+                    && get<quint32>(data + 4) == kVersion
+                    && entriesOffset + quint64(n) * kEntrySize <= quint64(size)
+                    && stringsOffset <= quint64(size);
+    if (!ok) {
+        close();
+        return false;
+    }
+
+    pack = QSharedPointer<ThumbnailPack>::create(packPath(projectFolder));
+    if (pack->size < qint64(get<quint64>(data + 32))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SessionSnapshot::close()
+{
+    if (data) file.unmap(const_cast<uchar *>(data));
+    data = nullptr;
+    size = 0;
+    file.close();
+    pack.reset();
+}
+
+int SessionSnapshot::count() const
+{
+    return data ? int(get<quint32>(data + 8)) : 0;
+}
+
+QString SessionSnapshot::folder() const
+{
+    if (!data) return QString();
+    const quint64 strings = get<quint64>(data + 48);
+    const quint32 off = get<quint32>(data + 56), len = get<quint32>(data + 60);
+    if (strings + off + len > quint64(size)) return QString();
+    return QString::fromUtf8(reinterpret_cast<const char *>(data + strings + off), int(len));
+}
+
+SessionSnapshot::Entry SessionSnapshot::entry(int index) const
+{
+    Entry e;
+    if (!data || index < 0 || index >= count()) return e;
+
+    const uchar *p = data + get<quint64>(data + 40) + quint64(index) * kEntrySize;
+    const quint64 strings = get<quint64>(data + 48);
+    auto str = [&](int field) {
+        const quint32 off = get<quint32>(p + field), len = get<quint32>(p + field + 4);
+        if (strings + off + len > quint64(size)) return QString();
+        return QString::fromUtf8(reinterpret_cast<const char *>(data + strings + off), int(len));
+    };
+
+    e.name = str(0);
+    e.path = str(8);
+    e.cameraGroup = str(16);
+    e.width = int(get<quint32>(p + 24));
+    e.height = int(get<quint32>(p + 28));
+    e.thumbOffset = qint64(get<quint64>(p + 32));
+    e.thumbLength = int(get<quint32>(p + 40));
+    e.selected = get<quint32>(p + 44) & 1;
+    const qint64 taken = get<qint64>(p + 48);
+    if (taken != std::numeric_limits<qint64>::min())
+        e.captureTime = QDateTime::fromMSecsSinceEpoch(taken, Qt::UTC);
+    e.latitude = get<double>(p + 56);
+    e.longitude = get<double>(p + 64);
+    e.sharpness = get<float>(p + 72);
+    return e;
+}
+
+QIcon SessionSnapshot::thumbnail(int index) const
+{
+    const Entry e = entry(index);
+    if (e.thumbLength <= 0) return QIcon();
+    return QIcon(new PackedIconEngine(pack, e.thumbOffset, e.thumbLength));
+}
+
+SessionSnapshot::PipelineStatus SessionSnapshot::pipelineStatus() const
+{
+    PipelineStatus s;
+    if (!data) return s;
+    const quint32 flags = get<quint32>(data + 12);
+    s.featuresDone = flags & FeaturesDone;
+    s.matchingDone = flags & MatchingDone;
+    s.sparseDone = flags & SparseDone;
+    s.undistortionDone = flags & UndistortionDone;
+    s.fusionDone = flags & FusionDone;
+    s.imagesWithFeatures = int(get<quint32>(data + 16));
+    s.depthMapsDone = int(get<quint32>(data + 20));
+    s.depthMapsTotal = int(get<quint32>(data + 24));
+    return s;
+}
+
+bool SessionSnapshot::write(const QString &projectFolder, const QString &folder,
+                            QVector<Entry> &entries, const PipelineCheckpoint &cp)
+{
+    const QString packFile = packPath(projectFolder);
+    QDir().mkpath(QFileInfo(packFile).absolutePath());
+
+    // Compact the pack if deleted images left more dead bytes than live ones
+    qint64 live = 0;
+    for (const Entry &e : entries)
+        if (e.thumbOffset >= 0) live += e.thumbLength;
+    const qint64 packSize = QFileInfo(packFile).size();
+    if (packSize > 2 * live && packSize > 0) {
+        ThumbnailPack old(packFile);
+        QSaveFile compacted(packFile);
+        if (!compacted.open(QIODevice::WriteOnly)) return false;
+        // The entries keep the old offsets until the new pack replaces the old one
+        QVector<qint64> moved(entries.size(), -1);
+        qint64 pos = 0;
+        for (int i = 0; i < entries.size(); ++i) {
+            const Entry &e = entries[i];
+            if (e.thumbOffset < 0 || !old.data || e.thumbOffset + e.thumbLength > old.size) continue;
+            compacted.write(reinterpret_cast<const char *>(old.data + e.thumbOffset), e.thumbLength);
+            moved[i] = pos;
+            pos += e.thumbLength;
+        }
+        if (!compacted.commit()) return false;
+        for (int i = 0; i < entries.size(); ++i)
+            entries[i].thumbOffset = moved[i];
+    }
+
+    // Append thumbnails that are not packed yet
+    QFile packOut(packFile);
+    if (!packOut.open(QIODevice::WriteOnly | QIODevice::Append)) return false;
+    QVector<int> appended;
+    bool written = true;
+    for (int i = 0; i < entries.size() && written; ++i) {
+        Entry &e = entries[i];
+        if (e.thumbOffset >= 0 || e.thumbnail.isNull()) continue;
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        e.thumbnail.save(&buffer, "JPG", 85);
+        e.thumbOffset = packOut.pos();
+        e.thumbLength = jpeg.size();
+        appended << i;
+        written = packOut.write(jpeg) == jpeg.size();
+    }
+    if (!written || !packOut.flush()) {
+        // Nothing appended this time is known to be on disk
+        for (int i : appended)
+            entries[i].thumbOffset = -1;
+        return false;
+    }
+    const qint64 finalPackSize = packOut.size();
+    packOut.close();
+
+    quint32 flags = 0;
+    if (cp.featuresDone) flags |= FeaturesDone;
+    if (cp.matchingDone) flags |= MatchingDone;
+    if (cp.sparseDone) flags |= SparseDone;
+    if (cp.undistortionDone) flags |= UndistortionDone;
+    if (cp.fusionDone) flags |= FusionDone;
+
+    StringTable strings;
+    QByteArray entryBytes;
+    entryBytes.reserve(entries.size() * kEntrySize);
+    for (const Entry &e : entries) {
+        const auto name = strings.add(e.name);
+        const auto path = strings.add(e.path);
+        const auto group = strings.add(e.cameraGroup);
+        put<quint32>(entryBytes, name.first);  put<quint32>(entryBytes, name.second);
+        put<quint32>(entryBytes, path.first);  put<quint32>(entryBytes, path.second);
+        put<quint32>(entryBytes, group.first); put<quint32>(entryBytes, group.second);
+        put<quint32>(entryBytes, quint32(e.width));
+        put<quint32>(entryBytes, quint32(e.height));
+        put<quint64>(entryBytes, quint64(e.thumbOffset < 0 ? 0 : e.thumbOffset));
+        put<quint32>(entryBytes, quint32(e.thumbOffset < 0 ? 0 : e.thumbLength));
+        put<quint32>(entryBytes, e.selected ? 1u : 0u);
+        put<qint64>(entryBytes, e.captureTime.isValid()
+                                    ? QDateTime(e.captureTime.date(), e.captureTime.time(), Qt::UTC).toMSecsSinceEpoch()
+                                    : std::numeric_limits<qint64>::min());
+        put<double>(entryBytes, e.latitude);
+        put<double>(entryBytes, e.longitude);
+        put<float>(entryBytes, e.sharpness);
+        put<quint32>(entryBytes, 0);
+    }
+    const auto folderString = strings.add(folder);
+
+    QByteArray header;
+    header.append(kMagic, 4);
+    put<quint32>(header, kVersion);
+    put<quint32>(header, quint32(entries.size()));
+    put<quint32>(header, flags);
+    put<quint32>(header, quint32(cp.imagesWithFeatures.size()));
+    put<quint32>(header, quint32(cp.depthMapsDone.size()));
+    put<quint32>(header, quint32(cp.depthMapsTotal));
+    put<quint32>(header, 0);
+    put<quint64>(header, quint64(finalPackSize));
+    put<quint64>(header, quint64(kHeaderSize));
+    put<quint64>(header, quint64(kHeaderSize + entryBytes.size()));
+    put<quint32>(header, folderString.first);
+    put<quint32>(header, folderString.second);
+
+    QSaveFile out(snapshotPath(projectFolder));
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    out.write(header);
+    out.write(entryBytes);
+    out.write(strings.bytes);
+    return out.commit();
+}
@@ -0,0 +1,94 @@
+#ifndef SESSIONSNAPSHOT_H
+#define SESSIONSNAPSHOT_H
+
+#include <QString>
+#include <QStringList>
+#include <QIcon>
+#include <QImage>
+#include <QVector>
+#include <QSharedPointer>
+#include <QFile>
+#include <QDateTime>
+#include <QtNumeric>
+
+class PipelineCheckpoint;
+class ThumbnailPack;
+
+// Image Manager state saved next to the project so it can be reopened
+// without reading a single source image.
+//
+// Two files live in <project>/.voxelforge:
+//   session.vfs      versioned binary snapshot: header, fixed-size entries,
+//                    UTF-8 string table (layout in sessionsnapshot.cpp)
+//   thumbnails.pack  append-only JPEG thumbnails the entries point into
+//
+// Both are memory-mapped on open. Entries are decoded on demand and
+// thumbnails are only decoded when their tile is first painted, so opening
+// costs the same for 200 or 20k images.
+class SessionSnapshot
+{
+public:
+    static const quint32 kVersion = 2;
+
+    struct Entry
+    {
+        QString name;
+        QString path;
+        QString cameraGroup;
+        int width = 0;
+        int height = 0;
+        QDateTime captureTime;      // invalid if unknown
+        double latitude = qQNaN();
+        double longitude = qQNaN();
+        float sharpness = -1.0f;    // ImageIndex::sharpness, < 0 if unknown
+        qint64 thumbOffset = -1;    // into thumbnails.pack, -1 if not packed yet
+        int thumbLength = 0;
+        bool selected = false;
+        QImage thumbnail;           // only used by write() for entries not packed yet
+    };
+
+    // Pipeline progress at the time of the snapshot
+    struct PipelineStatus
+    {
+        bool featuresDone = false;
+        bool matchingDone = false;
+        bool sparseDone = false;
+        bool undistortionDone = false;
+        bool fusionDone = false;
+        int imagesWithFeatures = 0;
+        int depthMapsDone = 0;
+        int depthMapsTotal = 0;
+    };
+
+    SessionSnapshot() = default;
+    ~SessionSnapshot();
+
+    static QString snapshotPath(const QString &projectFolder);
+    static QString packPath(const QString &projectFolder);
+
+    bool open(const QString &projectFolder);
+    void close();
+    bool isValid() const { return data != nullptr; }
+
+    QString folder() const;                 // folder the Image Manager was showing
+    int count() const;
+    Entry entry(int index) const;
+    QIcon thumbnail(int index) const;       // lazily decoded from the pack
+    PipelineStatus pipelineStatus() const;
+
+    // Writes a new snapshot. Entries without a pack offset get their
+    // thumbnail appended to the pack; the pack is compacted when more than
+    // half of it is dead. Pack offsets of the entries are updated in place
+    // and describe the pack on disk when this returns, even when it returns
+    // false: a compaction that committed has moved every thumbnail.
+    static bool write(const QString &projectFolder, const QString &folder,
+                      QVector<Entry> &entries, const PipelineCheckpoint &checkpoint);
+
+private:
+    QFile file;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+    QSharedPointer<ThumbnailPack> pack;
+};
+
+#endif // SESSIONSNAPSHOT_H
@@ -0,0 +1,630 @@
+#include "shardcoordinator.h"
+#include "shardprotocol.h"
+#include "pipelinecheckpoint.h"
+#include "cameragroups.h"
+#include "reconstructionpipeline.h"
+
+#include <QCoreApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+namespace
+{
+    const QStringList imageFilters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tiff"};
+    const qint64 kMaxNumImages = 2147483647;   // COLMAP's pair_id base
+    const int kWorkerQuitMs = 3000;            // grace for a told worker before it is terminated, then killed
+
+    bool writeList(const QString &path, const QStringList &names)
+    {
+        QSaveFile list(path);
+        if (!list.open(QIODevice::WriteOnly)) return false;
+        list.write((names.join('\n') + '\n').toUtf8());
+        return list.commit();
+    }
+
+    // Copies the matches and two-view geometries of a block database into
+    // the merged database, re-keying each pair by image name. Pairs already
+    // there (the ones inside a shard) are left alone. database_merger
+    // numbers images in input order and both databases list the lower
+    // shard first, so image_id1 < image_id2 holds on both sides and the
+    // match blobs never need their columns swapped.
+    QString importBlock(const QString &target, const QString &block)
+    {
+        static QAtomicInt connectionCounter;
+        const QString connectionName = QString("shardimport-%1").arg(connectionCounter.fetchAndAddRelaxed(1));
+
+        QString error;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            db.setDatabaseName(target);
+            if (!db.open()) {
+                error = db.lastError().text();
+            } else {
+                QSqlQuery q(db);
+                auto run = [&](const QString &sql) {
+                    if (error.isEmpty() && !q.exec(sql)) error = q.lastError().text();
+                };
+                q.prepare("ATTACH DATABASE ? AS block");
+                q.addBindValue(block);
+                if (!q.exec()) error = q.lastError().text();
+
+                run("BEGIN");
+                run("CREATE TEMP TABLE idmap (src INTEGER PRIMARY KEY, dst INTEGER)");
+                run("INSERT INTO idmap SELECT b.image_id, m.image_id FROM block.images b "
+                    "JOIN main.images m ON m.name = b.name");
+                for (const QString table : { QString("matches"), QString("two_view_geometries") }) {
+                    QStringList columns;
+                    if (error.isEmpty() && q.exec(QString("PRAGMA block.table_info(%1)").arg(table))) {
+                        while (q.next())
+                            if (q.value(1).toString() != "pair_id") columns << q.value(1).toString();
+                    }
+                    QStringList source;
+                    for (const QString &c : columns) source << "t." + c;
+                    run(QString("INSERT OR IGNORE INTO main.%1 (pair_id, %2) "
+                                "SELECT a.dst * %3 + b.dst, %4 FROM block.%1 t "
+                                "JOIN idmap a ON a.src = t.pair_id / %3 "
+                                "JOIN idmap b ON b.src = t.pair_id % %3")
+                            .arg(table, columns.join(", ")).arg(kMaxNumImages).arg(source.join(", ")));
+                }
+                if (error.isEmpty())
+                    run("COMMIT");
+                else
+                    q.exec("ROLLBACK");
+                q.exec("DROP TABLE idmap");
+                q.exec("DETACH DATABASE block");
+            }
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        return error;
+    }
+}
+
+ShardCoordinator::ShardCoordinator(const QString &projectFolder, QObject *parent)
+    : QObject(parent), project(projectFolder)
+{
+    shardFolder = QDir(project).filePath(".voxelforge/shards");
+
+    server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, &ShardCoordinator::onNewConnection);
+
+    tool = new QProcess(this);
+    tool->setProcessChannelMode(QProcess::MergedChannels);
+    connect(tool, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ShardCoordinator::onToolFinished);
+    connect(tool, &QProcess::readyReadStandardOutput, this, [this]() {
+        while (tool->canReadLine())
+            emit progress(QString::fromLocal8Bit(tool->readLine()).trimmed());
+    });
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+    stopWorkers();
+    if (tool->state() != QProcess::NotRunning) {
+        tool->disconnect(this);
+        tool->kill();
+        tool->waitForFinished(2000);
+    }
+}
+
+int ShardCoordinator::numaNodeCount()
+{
+    const QStringList nodes = QDir("/sys/devices/system/node")
+                                  .entryList(QDir::Dirs | QDir::NoDotAndDotDot)
+                                  .filter(QRegularExpression("^node\\d+$"));
+    return qMax(1, nodes.size());
+}
+
+bool ShardCoordinator::start(int shardCount, QString *error)
+{
+    if (isRunning()) {
+        *error = "Sharded extraction is already running.";
+        return false;
+    }
+
+    const QStringList images = QDir(project).entryList(imageFilters, QDir::Files, QDir::Name);
+    if (images.isEmpty()) {
+        *error = "The project folder has no images.";
+        return false;
+    }
+    shardCount = qBound(1, shardCount, images.size());
+
+    QDir(shardFolder).removeRecursively();
+    QDir().mkpath(shardFolder);
+
+    CameraGroups groups(project);
+    groups.load();
+    if (groups.addMissing(images))
+        groups.save();
+    const QVector<CameraGroup> cameraGroups = groups.groups();
+    const QHash<QString, QString> groupOf = groups.groupIds();
+
+    // Contiguous ranges: neighbouring file names are usually neighbouring
+    // shots, so most of the overlap stays inside one shard
+    shards.clear();
+    shards.resize(shardCount);
+    for (int k = 0; k < shardCount; ++k) {
+        Shard &s = shards[k];
+        const int begin = int(qint64(k) * images.size() / shardCount);
+        const int end = int(qint64(k + 1) * images.size() / shardCount);
+        s.imageCount = end - begin;
+        s.database = QDir(shardFolder).filePath(QString("shard_%1.db").arg(k));
+        s.imageList = QDir(shardFolder).filePath(QString("shard_%1.txt").arg(k));
+        if (!writeList(s.imageList, images.mid(begin, s.imageCount))) {
+            *error = "Could not write " + s.imageList;
+            return false;
+        }
+
+        // Split the shard by camera group so the worker can give each its own camera
+        QMap<QString, QStringList> byGroup;
+        for (const QString &name : images.mid(begin, s.imageCount))
+            byGroup[groupOf.value(name)] << name;
+
+        for (auto it = byGroup.constBegin(); it != byGroup.constEnd(); ++it) {
+            const QString listPath = QDir(shardFolder).filePath(QString("shard_%1_%2.txt").arg(k).arg(it.key()));
+            if (!writeList(listPath, it.value())) {
+                *error = "Could not write " + listPath;
+                return false;
+            }
+
+            QString params;
+            bool shared = false;
+            for (const CameraGroup &g : cameraGroups) {
+                if (g.id != it.key()) continue;
+                params = g.cameraParams();
+                shared = g.sharesCamera();
+            }
+            s.cameras.append(QJsonObject{ { "imageList", listPath }, { "cameraParams", params }, { "singleCamera", shared } });
+        }
+    }
+
+    if (!server->listen(QHostAddress::LocalHost, 0)) {
+        *error = "Could not open the worker socket: " + server->errorString();
+        return false;
+    }
+
+    // One local worker per shard, round-robin over the NUMA nodes
+    const QString endpoint = QString("%1:%2").arg(QHostAddress(QHostAddress::LocalHost).toString()).arg(server->serverPort());
+    const int nodes = numaNodeCount();
+    // The governor's thread budget is for the whole machine; split it over the workers
+    const int threads = governor ? qMax(1, governor->threadsFor(ReconstructionPipeline::FeatureExtraction) / shardCount) : 0;
+    for (int k = 0; k < shardCount; ++k) {
+        QProcess *p = new QProcess(this);
+        p->setStandardOutputFile(QProcess::nullDevice());
+        p->setStandardErrorFile(QProcess::nullDevice());
+        connect(p, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, p]() {
+            onLocalWorkerExited(p);
+        });
+        connect(p, &QProcess::errorOccurred, this, [this, p](QProcess::ProcessError e) {
+            if (e == QProcess::FailedToStart) onLocalWorkerExited(p);
+        });
+        QStringList args{ "--shard-worker", endpoint, "--numa-node", QString::number(k % nodes) };
+        if (threads > 0)
+            args << "--threads" << QString::number(threads);
+        startProcess(p, QCoreApplication::applicationFilePath(), args, ReconstructionPipeline::FeatureExtraction);
+        localWorkers << p;
+    }
+
+    blocks.clear();
+    merged = false;
+    phase = Sharding;
+    shardSeconds = mergeSeconds = crossSeconds = 0.0;
+    phaseTimer.start();
+    emit progress(QString("Extracting features in %1 shard(s) on %2 NUMA node(s)...").arg(shardCount).arg(nodes));
+    return true;
+}
+
+void ShardCoordinator::cancel()
+{
+    if (isRunning()) fail("Cancelled");
+}
+
+void ShardCoordinator::onNewConnection()
+{
+    while (server->hasPendingConnections()) {
+        QTcpSocket *socket = server->nextPendingConnection();
+        workers << socket;
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            for (const QJsonObject &msg : ShardProtocol::receive(socket))
+                onWorkerMessage(socket, msg);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { onWorkerGone(socket); });
+    }
+}
+
+void ShardCoordinator::onWorkerMessage(QTcpSocket *socket, const QJsonObject &msg)
+{
+    const QString type = msg.value("type").toString();
+    if (type == "hello") {
+        socket->setProperty("host", msg.value("host").toString());
+        idleWorkers << socket;
+        assignJobs();
+        return;
+    }
+
+    if (msg.value("kind").toString() == "block") {
+        const int index = msg.value("block").toInt(-1);
+        if (index < 0 || index >= blocks.size()) return;
+        Block &b = blocks[index];
+        if (type == "progress") {
+            emit progress(QString("[shards %1 x %2] %3").arg(b.a + 1).arg(b.b + 1).arg(msg.value("line").toString()));
+        } else if (type == "done") {
+            b.worker = nullptr;
+            if (!msg.value("ok").toBool()) {
+                fail(QString("Matching shards %1 x %2 failed (exit code %3)")
+                         .arg(b.a + 1).arg(b.b + 1).arg(msg.value("exitCode").toInt()));
+                return;
+            }
+            b.done = true;
+            b.seconds = msg.value("matchSeconds").toDouble();
+            idleWorkers << socket;
+            assignJobs();
+            importBlocks();
+        }
+        return;
+    }
+
+    const int index = msg.value("shard").toInt(-1);
+    if (index < 0 || index >= shards.size()) return;
+    Shard &s = shards[index];
+
+    if (type == "progress") {
+        emit progress(QString("[shard %1/%2] %3").arg(index + 1).arg(shards.size()).arg(msg.value("line").toString()));
+    } else if (type == "done") {
+        s.worker = nullptr;
+        if (!msg.value("ok").toBool()) {
+            fail(QString("Shard %1 failed (exit code %2)").arg(index + 1).arg(msg.value("exitCode").toInt()));
+            return;
+        }
+        s.done = true;
+        s.extractSeconds = msg.value("extractSeconds").toDouble();
+        s.matchSeconds = msg.value("matchSeconds").toDouble();
+        idleWorkers << socket;
+
+        for (const Shard &other : shards)
+            if (!other.done) {
+                assignJobs();
+                return;
+            }
+
+        shardSeconds = phaseTimer.elapsed() / 1000.0;
+        startCrossMatching();
+    }
+}
+
+void ShardCoordinator::onWorkerGone(QTcpSocket *socket)
+{
+    workers.removeAll(socket);
+    idleWorkers.removeAll(socket);
+    socket->deleteLater();
+
+    // A worker that dies mid-shard leaves a partial database behind; the
+    // next worker resumes it, since feature_extractor and the matcher skip
+    // what is already stored. A block is simply redone.
+    for (int k = 0; k < shards.size(); ++k) {
+        if (shards[k].worker == socket && !shards[k].done) {
+            shards[k].worker = nullptr;
+            emit progress(QString("Lost the worker for shard %1, requeueing it").arg(k + 1));
+        }
+    }
+    for (Block &b : blocks) {
+        if (b.worker == socket && !b.done) {
+            b.worker = nullptr;
+            emit progress(QString("Lost the worker for shards %1 x %2, requeueing it").arg(b.a + 1).arg(b.b + 1));
+        }
+    }
+    if (phase == Sharding || phase == CrossMatching) {
+        assignJobs();
+        if (workers.isEmpty() && localWorkers.isEmpty())
+            fail("All shard workers exited");
+    }
+}
+
+// A worker that never connected leaves nothing to requeue; once no worker
+// is left in any form the run cannot finish, so it fails instead of waiting
+void ShardCoordinator::onLocalWorkerExited(QProcess *process)
+{
+    if (!localWorkers.removeAll(process)) return;
+    const QString reason = process->error() == QProcess::FailedToStart
+                               ? process->errorString()
+                               : QString("exit code %1").arg(process->exitCode());
+    process->deleteLater();
+
+    if ((phase == Sharding || phase == CrossMatching) && workers.isEmpty() && localWorkers.isEmpty())
+        fail("The shard workers exited before connecting (" + reason + ")");
+}
+
+void ShardCoordinator::assignJobs()
+{
+    for (int k = 0; k < shards.size() && !idleWorkers.isEmpty(); ++k) {
+        Shard &s = shards[k];
+        if (s.done || s.worker) continue;
+
+        s.worker = idleWorkers.takeFirst();
+        s.host = s.worker->property("host").toString();
+        ShardProtocol::send(s.worker, QJsonObject{
+            { "type", "job" },
+            { "shard", k },
+            { "database", s.database },
+            { "imagePath", project },
+            { "cameras", s.cameras },
+        });
+    }
+
+    for (int k = 0; k < blocks.size() && !idleWorkers.isEmpty(); ++k) {
+        Block &b = blocks[k];
+        if (b.done || b.worker) continue;
+
+        b.worker = idleWorkers.takeFirst();
+        ShardProtocol::send(b.worker, QJsonObject{
+            { "type", "job" },
+            { "kind", "block" },
+            { "block", k },
+            { "database", b.database },
+            { "imagePath", project },
+            { "shards", QJsonArray{ shards[b.a].database, shards[b.b].database } },
+            { "imageLists", QJsonArray{ shards[b.a].imageList, shards[b.b].imageList } },
+            { "pairList", QDir(shardFolder).filePath(QString("block_%1_%2_pairs.txt").arg(b.a).arg(b.b)) },
+        });
+    }
+}
+
+// Folds the shard databases together one at a time with database_merger
+void ShardCoordinator::runNextMerge()
+{
+    if (mergeIndex < shards.size()) {
+        emit progress(QString("Merging shard databases (%1/%2)...").arg(mergeIndex).arg(shards.size() - 1));
+        const QString out = QDir(shardFolder).filePath(QString("merged_%1.db").arg(mergeIndex));
+        QFile::remove(out);
+        tool->setProperty("output", out);
+        startProcess(tool, "colmap", { "database_merger",
+                                       "--database_path1", mergedDatabase,
+                                       "--database_path2", shards[mergeIndex].database,
+                                       "--merged_database_path", out }, -1);
+        return;
+    }
+
+    const QString target = QDir(project).filePath("database.db");
+    if (QFile::exists(target)) {
+        QFile::remove(target + ".bak");
+        QFile::rename(target, target + ".bak");
+    }
+    if (!QFile::rename(mergedDatabase, target)) {
+        fail("Could not move the merged database to " + target);
+        return;
+    }
+    mergeSeconds = phaseTimer.elapsed() / 1000.0;
+    merged = true;
+    importBlocks();
+}
+
+// Every shard is extracted and matched inside itself: queue one block per
+// pair of shards for the workers, and merge the shard databases meanwhile
+void ShardCoordinator::startCrossMatching()
+{
+    phase = CrossMatching;
+    phaseTimer.restart();
+    for (int a = 0; a < shards.size(); ++a) {
+        for (int b = a + 1; b < shards.size(); ++b) {
+            Block block;
+            block.a = a;
+            block.b = b;
+            block.database = QDir(shardFolder).filePath(QString("block_%1_%2.db").arg(a).arg(b));
+            blocks << block;
+        }
+    }
+    emit progress(QString("Matching across shards in %1 block(s)...").arg(blocks.size()));
+    assignJobs();
+
+    mergeIndex = 1;
+    mergedDatabase = shards.first().database;
+    runNextMerge();
+}
+
+// Once the merged database and every block are there, copies the cross-shard
+// matches in. The copy is one SQLite writer, so it runs off the GUI thread.
+void ShardCoordinator::importBlocks()
+{
+    if (phase != CrossMatching || !merged) return;
+    for (const Block &b : blocks)
+        if (!b.done) return;
+
+    phase = Importing;
+    stopWorkers();
+    emit progress("Importing cross-shard matches...");
+
+    const QString target = QDir(project).filePath("database.db");
+    QStringList databases;
+    for (const Block &b : blocks)
+        databases << b.database;
+
+    auto *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher]() {
+        const QString error = watcher->result();
+        watcher->deleteLater();
+        if (phase != Importing) return;   // cancelled meanwhile
+        if (!error.isEmpty()) {
+            fail("Could not import the cross-shard matches: " + error);
+            return;
+        }
+        finishRun();
+    });
+    const QString projectFolder = project;
+    watcher->setFuture(QtConcurrent::run([projectFolder, target, databases]() {
+        // Every shard made its own camera per group; fold them back to one
+        CameraGroups groups(projectFolder);
+        groups.load();
+        QString error;
+        if (!groups.shareCameras(target, &error))
+            return "Could not merge the cameras per group: " + error;
+
+        for (const QString &db : databases) {
+            const QString error = importBlock(target, db);
+            if (!error.isEmpty()) return QFileInfo(db).fileName() + ": " + error;
+        }
+        return QString();
+    }));
+}
+
+void ShardCoordinator::finishRun()
+{
+    crossSeconds = phaseTimer.elapsed() / 1000.0;
+
+    // database.db now holds features and matches for every image
+    PipelineCheckpoint cp(project);
+    cp.load();
+    cp.matchingDone = true;
+    cp.save();
+
+    const QString report = scalingReport();
+    QDir(shardFolder).removeRecursively();
+    phase = Idle;
+    emit finished(true, report);
+}
+
+void ShardCoordinator::onToolFinished(int exitCode, QProcess::ExitStatus status)
+{
+    if (phase != CrossMatching) return;
+    if (status != QProcess::NormalExit || exitCode != 0) {
+        fail(QString("database_merger failed (exit code %1)").arg(exitCode));
+        return;
+    }
+
+    // Drop the previous intermediate, never a shard database
+    if (mergeIndex > 1)
+        QFile::remove(mergedDatabase);
+    mergedDatabase = tool->property("output").toString();
+    ++mergeIndex;
+    runNextMerge();
+}
+
+void ShardCoordinator::startProcess(QProcess *process, const QString &program, const QStringList &arguments, int stage)
+{
+    if (governor)
+        governor->start(process, program, arguments, stage);
+    else
+        process->start(program, arguments);
+}
+
+void ShardCoordinator::stopWorkers()
+{
+    if (governor) governor->resume();   // frozen workers could not read the quit message
+    for (QTcpSocket *socket : workers) {
+        ShardProtocol::send(socket, QJsonObject{ { "type", "quit" } });
+        socket->flush();
+    }
+    server->close();
+
+    // A worker still connecting never gets the message, and one may be
+    // stuck; none of the local ones may outlive the run
+    for (QProcess *p : localWorkers) {
+        QTimer::singleShot(kWorkerQuitMs, p, [p]() {
+            p->terminate();
+            QTimer::singleShot(kWorkerQuitMs, p, [p]() { p->kill(); });
+        });
+    }
+}
+
+void ShardCoordinator::fail(const QString &message)
+{
+    stopWorkers();
+    if (tool->state() != QProcess::NotRunning)
+        tool->kill();
+    phase = Idle;
+    emit finished(false, message);
+}
+
+// Wall time for this run, recorded per shard count so runs with different
+// counts on the same project can be compared
+QString ShardCoordinator::scalingReport()
+{
+    int images = 0;
+    double busy = 0.0;
+    QString perShard;
+    for (int k = 0; k < shards.size(); ++k) {
+        const Shard &s = shards[k];
+        images += s.imageCount;
+        busy += s.extractSeconds + s.matchSeconds;
+        perShard += QString("  shard %1 (%2): %3 images, extract %4 s, match %5 s\n")
+                        .arg(k + 1).arg(s.host).arg(s.imageCount)
+                        .arg(s.extractSeconds, 0, 'f', 1).arg(s.matchSeconds, 0, 'f', 1);
+    }
+
+    double blockSeconds = 0.0;
+    for (const Block &b : blocks)
+        blockSeconds += b.seconds;
+
+    // The merge runs while the workers match the blocks, so it is part of crossSeconds
+    const int n = shards.size();
+    const double total = shardSeconds + crossSeconds;
+    const double utilization = shardSeconds > 0 ? busy / (n * shardSeconds) : 0.0;
+    const double crossUtilization = crossSeconds > 0 && !blocks.isEmpty() ? blockSeconds / (n * crossSeconds) : 0.0;
+
+    // Load, update and rewrite the history
+    const QString historyPath = QDir(project).filePath(".voxelforge/shard_scaling.json");
+    QJsonObject history;
+    {
+        QFile f(historyPath);
+        if (f.open(QIODevice::ReadOnly))
+            history = QJsonDocument::fromJson(f.readAll()).object();
+    }
+    history[QString::number(n)] = QJsonObject{
+        { "images", images },
+        { "secondsPerImage", images > 0 ? total / images : 0.0 },
+        { "shardSeconds", shardSeconds },
+        { "mergeSeconds", mergeSeconds },
+        { "crossSeconds", crossSeconds },
+    };
+    QSaveFile out(historyPath);
+    if (out.open(QIODevice::WriteOnly)) {
+        out.write(QJsonDocument(history).toJson());
+        out.commit();
+    }
+
+    QString report = QString("%1 shard(s), %2 images in %3 s\n"
+                             "  shards %4 s, cross-shard matching %5 s in %6 block(s) (merge %7 s alongside)\n"
+                             "  parallel utilization: shard phase %8%, cross-shard phase %9%\n")
+                         .arg(n).arg(images).arg(total, 0, 'f', 1)
+                         .arg(shardSeconds, 0, 'f', 1).arg(crossSeconds, 0, 'f', 1).arg(blocks.size())
+                         .arg(mergeSeconds, 0, 'f', 1)
+                         .arg(utilization * 100.0, 0, 'f', 0).arg(crossUtilization * 100.0, 0, 'f', 0);
+    report += perShard;
+
+    // Efficiency against the single-shard run, per image so different image counts still compare
+    const double base = history.value("1").toObject().value("secondsPerImage").toDouble();
+    if (base > 0) {
+        report += "\nScaling efficiency vs 1 shard:\n";
+        QList<int> counts;
+        for (const QString &key : history.keys())
+            counts << key.toInt();
+        std::sort(counts.begin(), counts.end());
+        for (int count : counts) {
+            const double perImage = history.value(QString::number(count)).toObject().value("secondsPerImage").toDouble();
+            if (perImage <= 0) continue;
+            report += QString("  %1 shard(s): speedup %2x, efficiency %3%\n")
+                          .arg(count).arg(base / perImage, 0, 'f', 2)
+                          .arg(100.0 * base / (count * perImage), 0, 'f', 0);
+        }
+    } else {
+        report += "\nRun once with 1 shard to get a baseline for scaling efficiency.\n";
+    }
+    return report;
+}
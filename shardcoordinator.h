@@ -0,0 +1,119 @@
+#ifndef SHARDCOORDINATOR_H
+#define SHARDCOORDINATOR_H
+
+#include <QObject>
+#include <QProcess>
+#include <QVector>
+#include <QList>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QPointer>
+#include "resourcegovernor.h"
+
+class QTcpServer;
+class QTcpSocket;
+
+// Sharded feature extraction and matching for one project.
+//
+// The project's images are split into N contiguous shards. Each shard is
+// handed to a ShardWorker (a child process of this app, one per shard,
+// spread over the NUMA nodes), which extracts and matches it into its own
+// database under .voxelforge/shards. When every shard is done, the pairs
+// between shards are split into blocks, one per pair of shards (i, j), and
+// handed to the workers as well: a block merges the two shard databases
+// and matches exactly the i x j pairs with matches_importer. Meanwhile the
+// coordinator merges the shard databases into database.db; once both are
+// done the block matches are copied in, so every pair is matched once and
+// all of the matching runs in parallel.
+//
+// Workers are local child processes. They talk to the coordinator over a
+// loopback TCP socket on an ephemeral port (see ShardProtocol).
+class ShardCoordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ShardCoordinator(const QString &projectFolder, QObject *parent = nullptr);
+    ~ShardCoordinator() override;
+
+    static int numaNodeCount();
+
+    bool start(int shardCount, QString *error);
+    void cancel();
+    bool isRunning() const { return phase != Idle; }
+    QString projectFolder() const { return project; }
+
+    // Local workers and tools are started under the governor's limits when one is set
+    void setGovernor(ResourceGovernor *g) { governor = g; }
+
+signals:
+    void progress(const QString &message);
+    void finished(bool ok, const QString &report);
+
+private slots:
+    void onNewConnection();
+    void onToolFinished(int exitCode, QProcess::ExitStatus status);
+
+private:
+    enum Phase { Idle, Sharding, CrossMatching, Importing };
+
+    struct Shard
+    {
+        QJsonArray cameras;        // { imageList, cameraParams } per camera group
+        QString imageList;         // every image of the shard
+        QString database;
+        int imageCount = 0;
+        QTcpSocket *worker = nullptr;
+        QString host;
+        bool done = false;
+        double extractSeconds = 0.0;
+        double matchSeconds = 0.0;
+    };
+
+    // Matches between the images of shards a and b, a < b
+    struct Block
+    {
+        int a = 0;
+        int b = 0;
+        QString database;
+        QTcpSocket *worker = nullptr;
+        bool done = false;
+        double seconds = 0.0;
+    };
+
+    void onWorkerMessage(QTcpSocket *socket, const QJsonObject &msg);
+    void onWorkerGone(QTcpSocket *socket);
+    void onLocalWorkerExited(QProcess *process);
+    void assignJobs();
+    void runNextMerge();
+    void startCrossMatching();
+    void importBlocks();
+    void finishRun();
+    void stopWorkers();
+    void startProcess(QProcess *process, const QString &program, const QStringList &arguments, int stage);
+    void fail(const QString &message);
+    QString scalingReport();
+
+    QString project;
+    QString shardFolder;
+    QTcpServer *server = nullptr;
+    QList<QTcpSocket *> workers;       // every connected worker
+    QList<QTcpSocket *> idleWorkers;
+    QList<QProcess *> localWorkers;
+    QProcess *tool = nullptr;          // database_merger
+    QPointer<ResourceGovernor> governor;
+    QVector<Shard> shards;
+    QVector<Block> blocks;
+    Phase phase = Idle;
+
+    QString mergedDatabase;
+    int mergeIndex = 0;
+    bool merged = false;               // database.db holds every shard
+
+    QElapsedTimer phaseTimer;
+    double shardSeconds = 0.0;
+    double mergeSeconds = 0.0;
+    double crossSeconds = 0.0;
+};
+
+#endif // SHARDCOORDINATOR_H
@@ -0,0 +1,21 @@
+#include "shardprotocol.h"
+
+#include <QIODevice>
+#include <QJsonDocument>
+
+void ShardProtocol::send(QIODevice *device, const QJsonObject &message)
+{
+    device->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    device->write("\n");
+}
+
+QList<QJsonObject> ShardProtocol::receive(QIODevice *device)
+{
+    QList<QJsonObject> messages;
+    while (device->canReadLine()) {
+        const QJsonDocument doc = QJsonDocument::fromJson(device->readLine());
+        if (doc.isObject())
+            messages << doc.object();
+    }
+    return messages;
+}
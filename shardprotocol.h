@@ -0,0 +1,35 @@
+#ifndef SHARDPROTOCOL_H
+#define SHARDPROTOCOL_H
+
+#include <QJsonObject>
+#include <QList>
+
+class QIODevice;
+
+// Wire format between ShardCoordinator and ShardWorker: one compact JSON
+// object per line over TCP. Every message has a "type":
+//
+//   worker -> coordinator   hello    { host, pid, numaNode }
+//                           progress { shard | kind: "block", block, line }
+//                           done     { shard | kind: "block", block,
+//                                      ok, exitCode, extractSeconds, matchSeconds }
+//   coordinator -> worker   job      { shard, database, imagePath,
+//                                      cameras: [{ imageList, cameraParams, singleCamera }] }
+//                           job      { kind: "block", block, database, imagePath,
+//                                      shards: [dbA, dbB], imageLists: [listA, listB], pairList }
+//                           quit     {}
+//
+// A shard job extracts and matches one shard into its own database. A
+// block job merges two finished shard databases and matches every image of
+// shard A against every image of shard B.
+//
+// Paths in a job are absolute; workers run on the same machine.
+namespace ShardProtocol
+{
+    void send(QIODevice *device, const QJsonObject &message);
+
+    // Every complete message currently buffered on the device
+    QList<QJsonObject> receive(QIODevice *device);
+}
+
+#endif // SHARDPROTOCOL_H
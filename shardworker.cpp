@@ -0,0 +1,235 @@
+#include "shardworker.h"
+#include "shardprotocol.h"
+#include "reconstructionpipeline.h"
+#include "resourcegovernor.h"
+
+#include <QCoreApplication>
+#include <QTcpSocket>
+#include <QStandardPaths>
+#include <QHostInfo>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QFile>
+#include <QSaveFile>
+
+ShardWorker::ShardWorker(const QString &h, quint16 p, int node, int t, QObject *parent)
+    : QObject(parent), host(h), port(p), numaNode(node), threads(t)
+{
+    socket = new QTcpSocket(this);
+    connect(socket, &QTcpSocket::connected, this, &ShardWorker::onConnected);
+    connect(socket, &QTcpSocket::readyRead, this, &ShardWorker::onReadyRead);
+    connect(socket, &QTcpSocket::disconnected, qApp, &QCoreApplication::quit);
+    // disconnected never comes when the coordinator is gone before we connect
+    connect(socket, &QTcpSocket::errorOccurred, qApp, [](QAbstractSocket::SocketError e) {
+        if (e != QAbstractSocket::RemoteHostClosedError) QCoreApplication::exit(1);
+    });
+
+    process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(process, &QProcess::readyReadStandardOutput, this, &ShardWorker::onProcessOutput);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ShardWorker::onProcessFinished);
+}
+
+int ShardWorker::run(const QStringList &arguments)
+{
+    // arguments: <program> --shard-worker host:port [--numa-node N] [--threads N]
+    const QString address = arguments.value(2);
+    const int colon = address.lastIndexOf(':');
+    if (colon <= 0) {
+        QTextStream(stderr) << "usage: " << arguments.value(0)
+                            << " --shard-worker <host>:<port> [--numa-node N] [--threads N]\n";
+        return 2;
+    }
+
+    int numaNode = -1;
+    const int nodeArg = arguments.indexOf("--numa-node");
+    if (nodeArg > 0)
+        numaNode = arguments.value(nodeArg + 1).toInt();
+
+    int threads = 0;
+    const int threadsArg = arguments.indexOf("--threads");
+    if (threadsArg > 0)
+        threads = arguments.value(threadsArg + 1).toInt();
+
+    ShardWorker worker(address.left(colon), address.mid(colon + 1).toUShort(), numaNode, threads);
+    worker.start();
+    return QCoreApplication::exec();
+}
+
+void ShardWorker::start()
+{
+    socket->connectToHost(host, port);
+}
+
+void ShardWorker::onConnected()
+{
+    ShardProtocol::send(socket, QJsonObject{
+        { "type", "hello" },
+        { "host", QHostInfo::localHostName() },
+        { "pid", QCoreApplication::applicationPid() },
+        { "numaNode", numaNode },
+    });
+}
+
+void ShardWorker::onReadyRead()
+{
+    for (const QJsonObject &msg : ShardProtocol::receive(socket)) {
+        const QString type = msg.value("type").toString();
+        if (type == "quit") {
+            socket->disconnectFromHost();
+            QCoreApplication::quit();
+            return;
+        }
+        if (type == "job" && step == Idle) {
+            job = msg;
+            jobTimer.start();
+            if (job.value("kind").toString() == "block") {
+                startBlock();
+            } else {
+                step = Extracting;
+                cameraIndex = 0;
+                extractNextCamera();
+            }
+        }
+    }
+}
+
+// One feature_extractor run per camera group in the shard, so each group
+// shares one camera with its EXIF focal prior. The coordinator folds the
+// per-shard cameras of a group into one after merging.
+void ShardWorker::extractNextCamera()
+{
+    const QJsonObject camera = job.value("cameras").toArray().at(cameraIndex).toObject();
+    QStringList args{ "feature_extractor",
+                      "--database_path", job.value("database").toString(),
+                      "--image_path", job.value("imagePath").toString(),
+                      "--image_list_path", camera.value("imageList").toString() };
+    if (camera.value("singleCamera").toBool())
+        args << "--ImageReader.single_camera" << "1";
+    const QString params = camera.value("cameraParams").toString();
+    if (!params.isEmpty())
+        args << "--ImageReader.camera_model" << "SIMPLE_RADIAL" << "--ImageReader.camera_params" << params;
+    if (threads > 0)
+        args << ResourceGovernor::threadArguments(ReconstructionPipeline::FeatureExtraction, threads);
+    startColmap(args);
+}
+
+// A block starts from a fresh merge of its two shard databases, so a block
+// that was requeued after a lost worker never sees a half-written one
+void ShardWorker::startBlock()
+{
+    step = MergingBlock;
+    const QString database = job.value("database").toString();
+    QFile::remove(database);
+    const QJsonArray shards = job.value("shards").toArray();
+    startColmap({ "database_merger",
+                  "--database_path1", shards.at(0).toString(),
+                  "--database_path2", shards.at(1).toString(),
+                  "--merged_database_path", database });
+}
+
+// "nameA nameB" for every image of shard A against every image of shard B
+bool ShardWorker::writePairList() const
+{
+    QStringList lists[2];
+    const QJsonArray paths = job.value("imageLists").toArray();
+    for (int i = 0; i < 2; ++i) {
+        QFile f(paths.at(i).toString());
+        if (!f.open(QIODevice::ReadOnly)) return false;
+        lists[i] = QString::fromUtf8(f.readAll()).split('\n', Qt::SkipEmptyParts);
+    }
+
+    QSaveFile out(job.value("pairList").toString());
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    for (const QString &a : lists[0]) {
+        QByteArray chunk;
+        const QByteArray prefix = a.toUtf8() + ' ';
+        for (const QString &b : lists[1])
+            chunk += prefix + b.toUtf8() + '\n';
+        out.write(chunk);
+    }
+    return out.commit();
+}
+
+QJsonObject ShardWorker::reply(const QString &type) const
+{
+    QJsonObject msg{ { "type", type } };
+    for (const char *key : { "kind", "shard", "block" })
+        if (job.contains(key)) msg.insert(key, job.value(key));
+    return msg;
+}
+
+void ShardWorker::startColmap(const QStringList &arguments)
+{
+    stepTimer.start();
+
+    // Keep the threads and the memory they touch on one socket
+    const QString numactl = QStandardPaths::findExecutable("numactl");
+    if (numaNode >= 0 && !numactl.isEmpty()) {
+        QStringList args{ QString("--cpunodebind=%1").arg(numaNode), QString("--membind=%1").arg(numaNode), "colmap" };
+        process->start(numactl, args + arguments);
+    } else {
+        process->start("colmap", arguments);
+    }
+}
+
+void ShardWorker::onProcessOutput()
+{
+    while (process->canReadLine()) {
+        QJsonObject msg = reply("progress");
+        msg.insert("line", QString::fromLocal8Bit(process->readLine()).trimmed());
+        ShardProtocol::send(socket, msg);
+    }
+}
+
+void ShardWorker::onProcessFinished(int exitCode, QProcess::ExitStatus status)
+{
+    const bool ok = status == QProcess::NormalExit && exitCode == 0;
+    if (step == Extracting)
+        extractSeconds += stepTimer.elapsed() / 1000.0;
+
+    if (ok && step == MergingBlock) {
+        if (!writePairList()) {
+            sendDone(false, -1);
+            return;
+        }
+        step = MatchingBlock;
+        QStringList args{ "matches_importer", "--database_path", job.value("database").toString(),
+                          "--match_list_path", job.value("pairList").toString(), "--match_type", "pairs" };
+        if (threads > 0)
+            args << ResourceGovernor::threadArguments(ReconstructionPipeline::Matching, threads);
+        startColmap(args);
+        return;
+    }
+
+    if (ok && step == Extracting) {
+        if (++cameraIndex < job.value("cameras").toArray().size()) {
+            extractNextCamera();
+            return;
+        }
+        // Matching inside the shard; cross-shard pairs come back as block jobs
+        step = Matching;
+        QStringList args{ "exhaustive_matcher", "--database_path", job.value("database").toString() };
+        if (threads > 0)
+            args << ResourceGovernor::threadArguments(ReconstructionPipeline::Matching, threads);
+        startColmap(args);
+        return;
+    }
+    sendDone(ok, exitCode);
+}
+
+void ShardWorker::sendDone(bool ok, int exitCode)
+{
+    // A block's time is all matching, the merge included
+    const double matchSeconds = step == Matching ? stepTimer.elapsed() / 1000.0
+                                : step >= MergingBlock ? jobTimer.elapsed() / 1000.0 : 0.0;
+    QJsonObject msg = reply("done");
+    msg.insert("ok", ok);
+    msg.insert("exitCode", exitCode);
+    msg.insert("extractSeconds", extractSeconds);
+    msg.insert("matchSeconds", matchSeconds);
+    ShardProtocol::send(socket, msg);
+    step = Idle;
+    extractSeconds = 0.0;
+}
@@ -0,0 +1,62 @@
+#ifndef SHARDWORKER_H
+#define SHARDWORKER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QStringList>
+
+class QTcpSocket;
+
+// Headless worker for sharded feature extraction.
+//
+// Started as "Project3d --shard-worker <host>:<port> [--numa-node N] [--threads N]". It
+// connects to a ShardCoordinator, and for each shard job runs
+// feature_extractor (once per camera group) and then exhaustive_matcher on
+// the shard's own database. For a block job it merges two shard databases
+// and runs matches_importer on the pairs between them. Everything is
+// pinned to its NUMA node through numactl when that is installed.
+class ShardWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ShardWorker(const QString &host, quint16 port, int numaNode, int threads = 0, QObject *parent = nullptr);
+
+    // Entry point used by main() for the --shard-worker command line
+    static int run(const QStringList &arguments);
+
+    void start();
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onProcessOutput();
+    void onProcessFinished(int exitCode, QProcess::ExitStatus status);
+
+private:
+    void extractNextCamera();
+    void startBlock();
+    bool writePairList() const;
+    QJsonObject reply(const QString &type) const;
+    void startColmap(const QStringList &arguments);
+    void sendDone(bool ok, int exitCode);
+
+    QString host;
+    quint16 port;
+    int numaNode;
+    int threads;                  // COLMAP thread count per step, 0 = COLMAP's default
+    QTcpSocket *socket = nullptr;
+    QProcess *process = nullptr;
+
+    QJsonObject job;
+    enum Step { Idle, Extracting, Matching, MergingBlock, MatchingBlock };
+    int step = Idle;
+    int cameraIndex = 0;          // camera group being extracted
+    QElapsedTimer stepTimer;
+    QElapsedTimer jobTimer;
+    double extractSeconds = 0.0;
+};
+
+#endif // SHARDWORKER_H
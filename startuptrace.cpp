@@ -0,0 +1,59 @@
+#include "startuptrace.h"
+
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+
+namespace
+{
+    QElapsedTimer clock;
+    bool traceOn = false;
+    bool checkOn = false;
+    qint64 budgetMs = 0;   // 0 = no budget
+}
+
+void StartupTrace::start()
+{
+    clock.start();
+    traceOn = qEnvironmentVariableIntValue("VOXELFORGE_STARTUP_TRACE") != 0;
+    checkOn = qEnvironmentVariableIntValue("VOXELFORGE_STARTUP_CHECK") != 0;
+    budgetMs = qEnvironmentVariableIntValue("VOXELFORGE_STARTUP_BUDGET_MS");
+}
+
+bool StartupTrace::enabled()
+{
+    return traceOn;
+}
+
+qint64 StartupTrace::elapsedMs()
+{
+    return clock.isValid() ? clock.elapsed() : 0;
+}
+
+void StartupTrace::mark(const QString &what)
+{
+    if (!traceOn) return;
+    qInfo().noquote() << QString("[startup] %1 ms  %2").arg(elapsedMs(), 6).arg(what);
+}
+
+void StartupTrace::pageBuilt(const QString &page, qint64 nsecs)
+{
+    if (!traceOn) return;
+    mark(QString("built page \"%1\" in %2 ms").arg(page).arg(nsecs / 1e6, 0, 'f', 2));
+}
+
+void StartupTrace::firstPaint()
+{
+    const qint64 ms = elapsedMs();
+    mark("first paint");
+
+    const bool overBudget = budgetMs > 0 && ms > budgetMs;
+    if (overBudget)
+        qWarning().noquote() << QString("[startup] first paint took %1 ms, budget is %2 ms").arg(ms).arg(budgetMs);
+
+    if (checkOn) {
+        // Let the frame reach the screen, then leave with a status scripts can test.
+        QTimer::singleShot(0, qApp, [overBudget]() { QCoreApplication::exit(overBudget ? 1 : 0); });
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+// Lightweight cold-start trace.
+//
+// Enabled with VOXELFORGE_STARTUP_TRACE=1. Every mark is logged with the time
+// since process start. VOXELFORGE_STARTUP_BUDGET_MS sets a time-to-first-paint
+// target; when VOXELFORGE_STARTUP_CHECK=1 the app quits right after the first
+// paint with a non-zero exit code if the budget was exceeded, so the target
+// can be enforced from a script.
+namespace StartupTrace
+{
+    void start();                                   // call first thing in main()
+    bool enabled();
+    qint64 elapsedMs();
+    void mark(const QString &what);
+    void pageBuilt(const QString &page, qint64 nsecs);
+    void firstPaint();                              // called once by MainWindow
+}
+
+#endif // STARTUPTRACE_H